@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+//метод возвращает номер младшего единичного бита, word не равен нулю
+inline int CountTrailingZeros(uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(word);
+#else
+    int count = 0;
+    while ((word & 1) == 0) {
+        word >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
@@ -34,6 +34,7 @@ public:
 
     void Delete(const Key &key) {
         auto index = static_cast<uint64_t>(key) % bucket_count_;
+        std::lock_guard guard(mtx_[index]);
         auto it = map_[index].find(key);
         if (it != map_[index].end()) {
             map_[index].erase(it);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <ostream>
 #include <iostream>
 
@@ -11,6 +12,9 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+//количество статусов документов
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
 //структура документов
 struct Document {
     Document() = default;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "bit_utils.h"
+
+//битовая карта документов по внутренним номерам. поиск следующего отмеченного документа
+//проверяет по 64 номера за шаг, поэтому длинные отрезки неотмеченных документов пропускаются разом
+class DocumentBitmap {
+public:
+    //метод расширяет карту до size номеров, новые номера не отмечены
+    void Resize(size_t size) {
+        words_.resize((size + 63) / 64, 0);
+    }
+
+    void Set(int ordinal) {
+        words_[ordinal / 64] |= uint64_t{1} << (ordinal % 64);
+    }
+
+    void Reset(int ordinal) {
+        words_[ordinal / 64] &= ~(uint64_t{1} << (ordinal % 64));
+    }
+
+    bool Test(int ordinal) const {
+        return (words_[ordinal / 64] >> (ordinal % 64)) & 1;
+    }
+
+    //метод возвращает первый отмеченный номер из [ordinal, last_ordinal) или last_ordinal, если таких нет
+    int FindNext(int ordinal, int last_ordinal) const {
+        if (ordinal >= last_ordinal) {
+            return last_ordinal;
+        }
+        size_t index = ordinal / 64;
+        uint64_t word = words_[index] & (~uint64_t{0} << (ordinal % 64));
+        const size_t last_index = (static_cast<size_t>(last_ordinal) - 1) / 64;
+        while (word == 0) {
+            if (++index > last_index) {
+                return last_ordinal;
+            }
+            word = words_[index];
+        }
+        const int next = static_cast<int>(index * 64 + CountTrailingZeros(word));
+        return next < last_ordinal ? next : last_ordinal;
+    }
+
+private:
+    std::vector<uint64_t> words_;
+};
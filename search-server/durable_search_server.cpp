@@ -0,0 +1,107 @@
+#include "durable_search_server.h"
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+
+using namespace std;
+
+DurableSearchServer::DurableSearchServer(string_view stop_words_text, const string &snapshot_path, const string &log_path)
+        : snapshot_path_(snapshot_path), log_(log_path), search_server_(OpenSnapshot(stop_words_text, snapshot_path)) {
+    log_.Replay(search_server_);
+}
+
+//метод добавляет документ и возвращает управление, когда запись о нем попала на диск.
+//документ проверяется до записи в журнал, поэтому в журнал попадают только корректные изменения,
+//а в индекс он добавляется только после fsync: отказавший журнал не принимает запись, и индекс не меняется.
+//id добавляемого документа запоминается до применения, чтобы параллельное добавление того же id было отвергнуто
+void DurableSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int> &ratings) {
+    uint64_t sequence_number = 0;
+    {
+        lock_guard guard(mutex_);
+        if (pending_additions_.count(document_id) > 0) {
+            throw invalid_argument("Invalid document_id");
+        }
+        search_server_.CheckNewDocument(document_id, document);
+        sequence_number = log_.AppendAdd(document_id, document, status, ratings);
+        logged_count_ = sequence_number;
+        pending_additions_.insert(document_id);
+    }
+    ApplyDurable(sequence_number, [&](bool is_durable) {
+        if (is_durable) {
+            search_server_.AddDocument(document_id, document, status, ratings);
+        }
+        pending_additions_.erase(document_id);
+    });
+}
+
+//метод удаляет документ и возвращает управление, когда запись об удалении попала на диск
+void DurableSearchServer::RemoveDocument(int document_id) {
+    uint64_t sequence_number = 0;
+    {
+        lock_guard guard(mutex_);
+        sequence_number = log_.AppendRemove(document_id);
+        logged_count_ = sequence_number;
+    }
+    ApplyDurable(sequence_number, [&](bool is_durable) {
+        if (is_durable) {
+            search_server_.RemoveDocument(document_id);
+        }
+    });
+}
+
+//метод сохраняет снимок, проверяет его загрузкой и очищает журнал. Save сам пишет снимок во временный файл
+//и подменяет им прежний, записав переименование на диск, поэтому журнал очищается только после этого.
+//если сбой случится раньше, записи журнала просто доиграются поверх нового или прежнего снимка
+void DurableSearchServer::Checkpoint() {
+    unique_lock lock(mutex_);
+    //записи, уже попавшие в журнал, должны попасть в индекс до снимка, иначе очистка журнала их потеряет
+    applied_.wait(lock, [this] {
+        return applied_count_ == logged_count_;
+    });
+    log_.Sync();
+    search_server_.Save(snapshot_path_);
+    //снимок, который не загружается, не должен заменить журнал
+    SearchServer::Load(snapshot_path_);
+    log_.Reset();
+}
+
+//сервер для поиска
+const SearchServer &DurableSearchServer::GetServer() const {
+    return search_server_;
+}
+
+//метод ждет, пока запись не окажется на диске, и применяет изменения в порядке журнала: поток,
+//чья запись стала надежной раньше предыдущих, ждет их применения. запись, которую не удалось сбросить,
+//в индекс не попадает, ошибка журнала бросается после того, как очередь сдвинута
+template <typename Apply>
+void DurableSearchServer::ApplyDurable(uint64_t sequence_number, Apply apply) {
+    exception_ptr error;
+    try {
+        log_.WaitDurable(sequence_number);
+    } catch (...) {
+        error = current_exception();
+    }
+    unique_lock lock(mutex_);
+    applied_.wait(lock, [this, sequence_number] {
+        return applied_count_ + 1 == sequence_number;
+    });
+    try {
+        apply(!error);
+    } catch (...) {
+        if (!error) {
+            error = current_exception();
+        }
+    }
+    applied_count_ = sequence_number;
+    applied_.notify_all();
+    if (error) {
+        rethrow_exception(error);
+    }
+}
+
+SearchServer DurableSearchServer::OpenSnapshot(string_view stop_words_text, const string &snapshot_path) {
+    if (filesystem::exists(snapshot_path)) {
+        return SearchServer::Load(snapshot_path);
+    }
+    return SearchServer(stop_words_text);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <set>
+#include <mutex>
+#include <cstdint>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <string_view>
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+//поисковый сервер с журналом изменений: снимок плюс журнал упреждающей записи.
+//при открытии загружается последний снимок и доигрывается хвост журнала,
+//Checkpoint сохраняет новый снимок и очищает журнал
+class DurableSearchServer {
+public:
+    //стоп-слова используются, только если снимка еще нет, иначе они берутся из снимка
+    DurableSearchServer(std::string_view stop_words_text, const std::string &snapshot_path, const std::string &log_path);
+
+    //метод добавляет документ и возвращает управление, когда запись о нем попала на диск.
+    //несколько потоков могут добавлять документы одновременно, их записи сбрасываются одним fsync
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+
+    //метод удаляет документ и возвращает управление, когда запись об удалении попала на диск
+    void RemoveDocument(int document_id);
+
+    //метод дожидается применения всех записей журнала, сохраняет снимок и очищает журнал.
+    //снимок, который не удалось прочитать обратно, вызывает runtime_error, и журнал тогда не очищается
+    void Checkpoint();
+
+    //сервер для поиска. поиск не должен идти одновременно с изменениями
+    const SearchServer &GetServer() const;
+
+private:
+    std::string snapshot_path_;
+    WriteAheadLog log_;
+    std::mutex mutex_;
+    //очередь применения: записи журнала применяются к индексу по порядку номеров
+    std::condition_variable applied_;
+    //номер последней поставленной в журнал записи и последней примененной к индексу
+    uint64_t logged_count_ = 0;
+    uint64_t applied_count_ = 0;
+    //id документов, добавление которых записано в журнал, но еще не применено
+    std::set<int> pending_additions_;
+    SearchServer search_server_;
+
+    //метод ждет записи sequence_number на диск и вызывает apply(is_durable) под mutex_ в порядке журнала
+    template <typename Apply>
+    void ApplyDurable(uint64_t sequence_number, Apply apply);
+
+    static SearchServer OpenSnapshot(std::string_view stop_words_text, const std::string &snapshot_path);
+};
@@ -0,0 +1,96 @@
+#include "forward_index.h"
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+//метод дописывает документ со следующим номером
+void ForwardIndex::AddDocument(const vector<pair<TermId, double>> &term_freqs) {
+    for (const auto &[term, term_freq] : term_freqs) {
+        terms_.push_back(term);
+        term_freqs_.push_back(term_freq);
+    }
+    offsets_.push_back(terms_.size());
+}
+
+//метод возвращает слова документа: документы снимка читаются из отображенного файла
+ForwardIndex::DocumentTerms ForwardIndex::GetDocument(int ordinal) const {
+    const auto index = static_cast<size_t>(ordinal);
+    if (index < attached_count_) {
+        const uint64_t begin = attached_offsets_[index];
+        return {attached_terms_ + begin, attached_term_freqs_ + begin, static_cast<size_t>(attached_offsets_[index + 1] - begin)};
+    }
+    const uint64_t begin = offsets_[index - attached_count_];
+    return {terms_.data() + begin, term_freqs_.data() + begin, static_cast<size_t>(offsets_[index - attached_count_ + 1] - begin)};
+}
+
+//метод возвращает количество документов, включая удаленные, но еще не вычищенные
+size_t ForwardIndex::GetDocumentCount() const {
+    return attached_count_ + offsets_.size() - 1;
+}
+
+//метод оставляет живые документы под новыми номерами и с новыми id слов,
+//слова документов снимка копируются в собственные массивы
+void ForwardIndex::Compact(const vector<int> &new_ordinals, const vector<TermId> &new_terms) {
+    ForwardIndex compacted;
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] < 0) {
+            continue;
+        }
+        const DocumentTerms document = GetDocument(static_cast<int>(ordinal));
+        for (const TermId term : document) {
+            compacted.terms_.push_back(new_terms[term]);
+        }
+        compacted.term_freqs_.insert(compacted.term_freqs_.end(), document.term_freqs, document.term_freqs + document.size);
+        compacted.offsets_.push_back(compacted.terms_.size());
+    }
+    *this = move(compacted);
+}
+
+//метод пишет в снимок живые документы: количество слов всех документов, накопленные количества, id слов и TF
+void ForwardIndex::Save(SnapshotWriter &writer, const vector<int> &new_ordinals) const {
+    vector<uint64_t> offsets = {0};
+    vector<TermId> terms;
+    vector<double> term_freqs;
+    for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+        if (new_ordinals[ordinal] < 0) {
+            continue;
+        }
+        const DocumentTerms document = GetDocument(static_cast<int>(ordinal));
+        terms.insert(terms.end(), document.terms, document.terms + document.size);
+        term_freqs.insert(term_freqs.end(), document.term_freqs, document.term_freqs + document.size);
+        offsets.push_back(terms.size());
+    }
+    writer.Write(static_cast<uint64_t>(terms.size()));
+    writer.WriteArray(offsets);
+    writer.WriteArray(terms);
+    writer.WriteArray(term_freqs);
+}
+
+//метод подключает прямой индекс из снимка без копирования, разметка и слова всех документов проверяются
+void ForwardIndex::Attach(SnapshotReader &reader, size_t document_count, size_t term_count, shared_ptr<const void> owner) {
+    const auto check = [](bool condition) {
+        if (!condition) {
+            throw runtime_error("Snapshot forward index is corrupted");
+        }
+    };
+    const auto posting_count = reader.Read<uint64_t>();
+    const uint64_t *offsets = reader.ReadArray<uint64_t>(document_count + 1);
+    const TermId *terms = reader.ReadArray<TermId>(posting_count);
+    const double *term_freqs = reader.ReadArray<double>(posting_count);
+    check(offsets[0] == 0 && offsets[document_count] == posting_count);
+    for (size_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        check(offsets[ordinal] <= offsets[ordinal + 1]);
+        for (uint64_t i = offsets[ordinal]; i < offsets[ordinal + 1]; ++i) {
+            check(terms[i] < term_count && (i == offsets[ordinal] || terms[i - 1] < terms[i]));
+            check(term_freqs[i] > 0.0 && isfinite(term_freqs[i]));
+        }
+    }
+
+    *this = ForwardIndex();
+    attached_count_ = document_count;
+    attached_offsets_ = offsets;
+    attached_terms_ = terms;
+    attached_term_freqs_ = term_freqs;
+    owner_ = move(owner);
+}
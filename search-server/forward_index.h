@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "snapshot_io.h"
+#include "term_dictionary.h"
+
+//прямой индекс: для каждого внутреннего номера документа id его различных слов по возрастанию и их TF.
+//слова документов лежат подряд в плоских массивах. документы, загруженные из снимка, читаются прямо
+//из отображенного в память файла, документы, добавленные после загрузки, дописываются в собственные массивы.
+//слова удаленного документа остаются в массивах до уплотнения
+class ForwardIndex {
+public:
+    //слова документа: id по возрастанию и TF в том же порядке
+    struct DocumentTerms {
+        const TermId *terms = nullptr;
+        const double *term_freqs = nullptr;
+        size_t size = 0;
+
+        const TermId *begin() const {
+            return terms;
+        }
+        const TermId *end() const {
+            return terms + size;
+        }
+    };
+
+    //метод дописывает документ со следующим номером, пары «id слова — TF» идут по возрастанию id
+    void AddDocument(const std::vector<std::pair<TermId, double>> &term_freqs);
+
+    //метод возвращает слова документа
+    DocumentTerms GetDocument(int ordinal) const;
+
+    //метод возвращает количество документов, включая удаленные, но еще не вычищенные
+    size_t GetDocumentCount() const;
+
+    //метод оставляет документы с new_ordinals[ordinal] >= 0 под новыми номерами, порядок номеров сохраняется,
+    //id слов заменяются на new_terms[term] с тем же порядком. слова документов снимка копируются в собственные массивы
+    void Compact(const std::vector<int> &new_ordinals, const std::vector<TermId> &new_terms);
+
+    //метод пишет в снимок документы с new_ordinals[ordinal] >= 0 в порядке номеров
+    void Save(SnapshotWriter &writer, const std::vector<int> &new_ordinals) const;
+
+    //метод подключает прямой индекс document_count документов из снимка без копирования, owner удерживает память снимка.
+    //id слов каждого документа должны строго возрастать и быть меньше term_count, TF — быть положительными,
+    //иначе бросается runtime_error
+    void Attach(SnapshotReader &reader, size_t document_count, size_t term_count, std::shared_ptr<const void> owner);
+
+private:
+    //документы снимка с номерами меньше attached_count_: накопленные количества слов
+    //(attached_count_ + 1 значений), id слов и их TF в отображенном файле
+    size_t attached_count_ = 0;
+    const uint64_t *attached_offsets_ = nullptr;
+    const TermId *attached_terms_ = nullptr;
+    const double *attached_term_freqs_ = nullptr;
+    //владелец подключенных массивов
+    std::shared_ptr<const void> owner_;
+    //документы с номерами от attached_count_
+    std::vector<uint64_t> offsets_ = {0};
+    std::vector<TermId> terms_;
+    std::vector<double> term_freqs_;
+};
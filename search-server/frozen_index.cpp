@@ -0,0 +1,366 @@
+#include "frozen_index.h"
+#include <cmath>
+#include <stdexcept>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FROZEN_INDEX_USE_SSE2 1
+#endif
+
+using namespace std;
+
+namespace {
+    //формат блока: код ширины разностей номеров в младших двух битах, код ширины чисел вхождений в следующих.
+    //код 0 — 1 байт, 1 — 2 байта, 2 — 4 байта
+    uint8_t GetWidthCode(uint32_t max_value) {
+        return max_value <= UINT8_MAX ? 0 : max_value <= UINT16_MAX ? 1 : 2;
+    }
+
+    size_t GetWidth(uint8_t code) {
+        return size_t{1} << code;
+    }
+
+    void AppendValue(vector<uint8_t> &data, uint32_t value, size_t width) {
+        const size_t size = data.size();
+        data.resize(size + width);
+        //младшие байты значения, порядок байт совпадает с порядком при чтении
+        if (width == 1) {
+            data[size] = static_cast<uint8_t>(value);
+        } else if (width == 2) {
+            const auto narrow = static_cast<uint16_t>(value);
+            memcpy(data.data() + size, &narrow, width);
+        } else {
+            memcpy(data.data() + size, &value, width);
+        }
+    }
+
+    //метод распаковывает count значений ширины width
+    void UnpackValues(const uint8_t *data, size_t width, size_t count, uint32_t *values) {
+        if (width == 1) {
+            for (size_t i = 0; i < count; ++i) {
+                values[i] = data[i];
+            }
+        } else if (width == 2) {
+            for (size_t i = 0; i < count; ++i) {
+                uint16_t value;
+                memcpy(&value, data + i * 2, sizeof(value));
+                values[i] = value;
+            }
+        } else {
+            memcpy(values, data, count * sizeof(uint32_t));
+        }
+    }
+
+#ifdef FROZEN_INDEX_USE_SSE2
+    //префиксная сумма четырех разностей с переносом от предыдущей четверки
+    inline void StorePrefixSum(__m128i deltas, __m128i &carry, int *ordinals) {
+        deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+        deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+        deltas = _mm_add_epi32(deltas, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(ordinals), deltas);
+        carry = _mm_shuffle_epi32(deltas, 0xFF);
+    }
+#endif
+
+    //метод восстанавливает номера документов из разностей: ordinals[i] = base + сумма первых i + 1 разностей.
+    //при SSE2 по 16 (1 байт) или 8 (2 байта) разностей расширяются до 32 бит и суммируются в регистрах
+    void DecodeOrdinals(const uint8_t *data, size_t width, size_t count, int base, int *ordinals) {
+        size_t i = 0;
+#ifdef FROZEN_INDEX_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i carry = _mm_set1_epi32(base);
+        if (width == 1) {
+            for (; i + 16 <= count; i += 16) {
+                const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+                const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+                StorePrefixSum(_mm_unpacklo_epi16(low, zero), carry, ordinals + i);
+                StorePrefixSum(_mm_unpackhi_epi16(low, zero), carry, ordinals + i + 4);
+                StorePrefixSum(_mm_unpacklo_epi16(high, zero), carry, ordinals + i + 8);
+                StorePrefixSum(_mm_unpackhi_epi16(high, zero), carry, ordinals + i + 12);
+            }
+        } else if (width == 2) {
+            for (; i + 8 <= count; i += 8) {
+                const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 2));
+                StorePrefixSum(_mm_unpacklo_epi16(words, zero), carry, ordinals + i);
+                StorePrefixSum(_mm_unpackhi_epi16(words, zero), carry, ordinals + i + 4);
+            }
+        } else {
+            for (; i + 4 <= count; i += 4) {
+                StorePrefixSum(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 4)), carry, ordinals + i);
+            }
+        }
+        if (i > 0) {
+            base = ordinals[i - 1];
+        }
+#endif
+        uint32_t deltas[POSTING_BLOCK_SIZE];
+        UnpackValues(data + i * width, width, count - i, deltas);
+        for (size_t j = 0; i < count; ++i, ++j) {
+            base += static_cast<int>(deltas[j]);
+            ordinals[i] = base;
+        }
+    }
+}
+
+FrozenIndex::FrozenIndex() {
+    Refresh();
+}
+
+FrozenIndex::FrozenIndex(const FrozenIndex &other)
+        : slot_postings_(other.slot_postings_), slot_blocks_(other.slot_blocks_),
+          block_last_ordinals_(other.block_last_ordinals_), block_max_weights_(other.block_max_weights_),
+          block_offsets_(other.block_offsets_),
+          block_formats_(other.block_formats_), data_(other.data_), layout_(other.layout_), owner_(other.owner_) {
+    if (!owner_) {
+        Refresh();
+    }
+}
+
+FrozenIndex &FrozenIndex::operator=(const FrozenIndex &other) {
+    FrozenIndex copy(other);
+    Swap(copy);
+    return *this;
+}
+
+FrozenIndex::FrozenIndex(FrozenIndex &&other) noexcept
+        : FrozenIndex() {
+    Swap(other);
+}
+
+FrozenIndex &FrozenIndex::operator=(FrozenIndex &&other) noexcept {
+    FrozenIndex moved(move(other));
+    Swap(moved);
+    return *this;
+}
+
+//метод добавляет список постингов очередного слова, возвращает номер слота
+size_t FrozenIndex::AddPostings(const vector<FrozenPosting> &postings) {
+    Materialize();
+    int previous = -1;
+    for (size_t begin = 0; begin < postings.size(); begin += POSTING_BLOCK_SIZE) {
+        const size_t end = min(postings.size(), begin + POSTING_BLOCK_SIZE);
+        uint32_t max_delta = 0;
+        uint32_t max_count = 0;
+        double max_weight = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            max_delta = max(max_delta, static_cast<uint32_t>(postings[i].ordinal - (i == begin ? previous : postings[i - 1].ordinal)));
+            max_count = max(max_count, postings[i].count);
+            max_weight = max(max_weight, postings[i].weight);
+        }
+        const uint8_t delta_code = GetWidthCode(max_delta);
+        const uint8_t count_code = GetWidthCode(max_count);
+        for (size_t i = begin; i < end; ++i) {
+            AppendValue(data_, static_cast<uint32_t>(postings[i].ordinal - previous), GetWidth(delta_code));
+            previous = postings[i].ordinal;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            AppendValue(data_, postings[i].count, GetWidth(count_code));
+        }
+        block_last_ordinals_.push_back(previous);
+        block_max_weights_.push_back(max_weight);
+        block_formats_.push_back(static_cast<uint8_t>(delta_code | count_code << 2));
+        block_offsets_.push_back(data_.size());
+    }
+    slot_postings_.push_back(slot_postings_.back() + postings.size());
+    slot_blocks_.push_back(block_last_ordinals_.size());
+    Refresh();
+    return slot_postings_.size() - 2;
+}
+
+//метод добавляет слотом список постингов слота другого индекса: блоки, их границы и форматы копируются
+//без распаковки, сдвигаются только смещения блоков в данных
+size_t FrozenIndex::AddPostings(const FrozenIndex &source, size_t slot) {
+    Materialize();
+    const Layout &layout = source.layout_;
+    const uint64_t begin_block = layout.slot_blocks[slot];
+    const uint64_t end_block = layout.slot_blocks[slot + 1];
+    const uint64_t begin_offset = layout.block_offsets[begin_block];
+    const uint64_t data_offset = data_.size();
+    data_.insert(data_.end(), layout.data + begin_offset, layout.data + layout.block_offsets[end_block]);
+    block_last_ordinals_.insert(block_last_ordinals_.end(), layout.block_last_ordinals + begin_block, layout.block_last_ordinals + end_block);
+    block_max_weights_.insert(block_max_weights_.end(), layout.block_max_weights + begin_block, layout.block_max_weights + end_block);
+    block_formats_.insert(block_formats_.end(), layout.block_formats + begin_block, layout.block_formats + end_block);
+    for (uint64_t block = begin_block; block < end_block; ++block) {
+        block_offsets_.push_back(layout.block_offsets[block + 1] - begin_offset + data_offset);
+    }
+    slot_postings_.push_back(slot_postings_.back() + source.GetPostingCount(slot));
+    slot_blocks_.push_back(block_last_ordinals_.size());
+    Refresh();
+    return slot_postings_.size() - 2;
+}
+
+//метод проверяет наличие документа в списке постингов слота, распаковывается один блок
+bool FrozenIndex::Contains(size_t slot, int ordinal) const {
+    const int32_t *last_ordinals = layout_.block_last_ordinals;
+    const int32_t *end = last_ordinals + layout_.slot_blocks[slot + 1];
+    const int32_t *it = lower_bound(last_ordinals + layout_.slot_blocks[slot], end, ordinal);
+    if (it == end) {
+        return false;
+    }
+    int ordinals[POSTING_BLOCK_SIZE];
+    uint32_t counts[POSTING_BLOCK_SIZE];
+    const size_t count = DecodeBlock(slot, it - last_ordinals, ordinals, counts);
+    return binary_search(ordinals, ordinals + count, ordinal);
+}
+
+//метод возвращает количество постингов слота
+size_t FrozenIndex::GetPostingCount(size_t slot) const {
+    return layout_.slot_postings[slot + 1] - layout_.slot_postings[slot];
+}
+
+//метод возвращает наибольший вес постинга слота по границам его блоков
+double FrozenIndex::GetMaxWeight(size_t slot) const {
+    const double *begin = layout_.block_max_weights + layout_.slot_blocks[slot];
+    const double *end = layout_.block_max_weights + layout_.slot_blocks[slot + 1];
+    return begin == end ? 0.0 : *max_element(begin, end);
+}
+
+//метод возвращает количество слотов
+size_t FrozenIndex::GetSlotCount() const {
+    return layout_.slot_count;
+}
+
+//метод возвращает общее количество постингов
+size_t FrozenIndex::GetPostingCount() const {
+    return layout_.slot_postings[layout_.slot_count];
+}
+
+//метод освобождает память индекса
+void FrozenIndex::Clear() {
+    *this = FrozenIndex();
+}
+
+//метод пишет сжатые списки в снимок
+void FrozenIndex::Save(SnapshotWriter &writer) const {
+    const uint64_t block_count = layout_.slot_blocks[layout_.slot_count];
+    const uint64_t data_size = layout_.block_offsets[block_count];
+    writer.Write(static_cast<uint64_t>(layout_.slot_count));
+    writer.Write(block_count);
+    writer.Write(data_size);
+    writer.WriteArray(layout_.slot_postings, layout_.slot_count + 1);
+    writer.WriteArray(layout_.slot_blocks, layout_.slot_count + 1);
+    writer.WriteArray(layout_.block_last_ordinals, block_count);
+    writer.WriteArray(layout_.block_max_weights, block_count);
+    writer.WriteArray(layout_.block_offsets, block_count + 1);
+    writer.WriteArray(layout_.block_formats, block_count);
+    writer.WriteArray(layout_.data, data_size);
+}
+
+//метод подключает сжатые списки из снимка без копирования. проверяется разметка (границы слотов и блоков,
+//форматы, последние номера и веса блоков) и содержимое каждого блока: номера документов строго растут,
+//последний совпадает с разметкой, числа вхождений положительны. после проверки распаковка не выходит за номера документов
+void FrozenIndex::Attach(SnapshotReader &reader, int ordinal_count, shared_ptr<const void> owner) {
+    const auto check = [](bool condition) {
+        if (!condition) {
+            throw runtime_error("Snapshot postings are corrupted");
+        }
+    };
+    Layout layout;
+    layout.slot_count = reader.Read<uint64_t>();
+    const auto block_count = reader.Read<uint64_t>();
+    const auto data_size = reader.Read<uint64_t>();
+    //массивы границ на одно значение длиннее, размер не должен переполняться
+    check(layout.slot_count < numeric_limits<uint64_t>::max() && block_count < numeric_limits<uint64_t>::max());
+    layout.slot_postings = reader.ReadArray<uint64_t>(layout.slot_count + 1);
+    layout.slot_blocks = reader.ReadArray<uint64_t>(layout.slot_count + 1);
+    layout.block_last_ordinals = reader.ReadArray<int32_t>(block_count);
+    layout.block_max_weights = reader.ReadArray<double>(block_count);
+    layout.block_offsets = reader.ReadArray<uint64_t>(block_count + 1);
+    layout.block_formats = reader.ReadArray<uint8_t>(block_count);
+    layout.data = reader.ReadArray<uint8_t>(data_size);
+
+    uint32_t deltas[POSTING_BLOCK_SIZE];
+    uint32_t counts[POSTING_BLOCK_SIZE];
+    check(layout.slot_postings[0] == 0 && layout.slot_blocks[0] == 0 && layout.block_offsets[0] == 0);
+    check(layout.slot_blocks[layout.slot_count] == block_count && layout.block_offsets[block_count] == data_size);
+    for (size_t slot = 0; slot < layout.slot_count; ++slot) {
+        check(layout.slot_postings[slot] <= layout.slot_postings[slot + 1]);
+        const uint64_t posting_count = layout.slot_postings[slot + 1] - layout.slot_postings[slot];
+        const uint64_t first_block = layout.slot_blocks[slot];
+        check(first_block <= layout.slot_blocks[slot + 1]
+              && layout.slot_blocks[slot + 1] - first_block == (posting_count + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE);
+        for (uint64_t block = first_block; block < layout.slot_blocks[slot + 1]; ++block) {
+            const uint8_t format = layout.block_formats[block];
+            check((format & 3) < 3 && (format >> 2) < 3);
+            const int32_t last_ordinal = layout.block_last_ordinals[block];
+            check(last_ordinal < ordinal_count && last_ordinal > (block == first_block ? -1 : layout.block_last_ordinals[block - 1]));
+            check(layout.block_max_weights[block] >= 0.0 && isfinite(layout.block_max_weights[block]));
+            const uint64_t count = min<uint64_t>(POSTING_BLOCK_SIZE, posting_count - (block - first_block) * POSTING_BLOCK_SIZE);
+            const size_t delta_width = GetWidth(format & 3);
+            check(layout.block_offsets[block] <= layout.block_offsets[block + 1]
+                  && layout.block_offsets[block + 1] - layout.block_offsets[block] == count * (delta_width + GetWidth(format >> 2)));
+            //разности и числа вхождений читаются без знака, номер накапливается в 64 битах и не переполняется
+            const uint8_t *data = layout.data + layout.block_offsets[block];
+            UnpackValues(data, delta_width, count, deltas);
+            UnpackValues(data + count * delta_width, GetWidth(format >> 2), count, counts);
+            int64_t ordinal = block == first_block ? -1 : layout.block_last_ordinals[block - 1];
+            for (size_t i = 0; i < count; ++i) {
+                check(deltas[i] > 0 && counts[i] > 0);
+                ordinal += deltas[i];
+            }
+            check(ordinal == last_ordinal);
+        }
+    }
+
+    *this = FrozenIndex();
+    layout_ = layout;
+    owner_ = move(owner);
+}
+
+//метод распаковывает блок слота, возвращает количество постингов в нем
+size_t FrozenIndex::DecodeBlock(size_t slot, size_t block, int *ordinals, uint32_t *counts) const {
+    const uint64_t first_block = layout_.slot_blocks[slot];
+    const size_t count = min<uint64_t>(POSTING_BLOCK_SIZE, GetPostingCount(slot) - (block - first_block) * POSTING_BLOCK_SIZE);
+    const int base = block == first_block ? -1 : layout_.block_last_ordinals[block - 1];
+    const uint8_t format = layout_.block_formats[block];
+    const size_t delta_width = GetWidth(format & 3);
+    const uint8_t *data = layout_.data + layout_.block_offsets[block];
+    DecodeOrdinals(data, delta_width, count, base, ordinals);
+    UnpackValues(data + count * delta_width, GetWidth(format >> 2), count, counts);
+    return count;
+}
+
+//метод направляет layout_ на собственные массивы
+void FrozenIndex::Refresh() {
+    layout_.slot_postings = slot_postings_.data();
+    layout_.slot_blocks = slot_blocks_.data();
+    layout_.block_last_ordinals = block_last_ordinals_.data();
+    layout_.block_max_weights = block_max_weights_.data();
+    layout_.block_offsets = block_offsets_.data();
+    layout_.block_formats = block_formats_.data();
+    layout_.data = data_.data();
+    layout_.slot_count = slot_postings_.size() - 1;
+}
+
+//метод обменивает содержимое индексов, буферы векторов при обмене не перемещаются
+void FrozenIndex::Swap(FrozenIndex &other) noexcept {
+    slot_postings_.swap(other.slot_postings_);
+    slot_blocks_.swap(other.slot_blocks_);
+    block_last_ordinals_.swap(other.block_last_ordinals_);
+    block_max_weights_.swap(other.block_max_weights_);
+    block_offsets_.swap(other.block_offsets_);
+    block_formats_.swap(other.block_formats_);
+    data_.swap(other.data_);
+    swap(layout_, other.layout_);
+    owner_.swap(other.owner_);
+}
+
+//метод копирует подключенные массивы в память индекса
+void FrozenIndex::Materialize() {
+    if (!owner_) {
+        return;
+    }
+    const Layout layout = layout_;
+    const uint64_t block_count = layout.slot_blocks[layout.slot_count];
+    slot_postings_.assign(layout.slot_postings, layout.slot_postings + layout.slot_count + 1);
+    slot_blocks_.assign(layout.slot_blocks, layout.slot_blocks + layout.slot_count + 1);
+    block_last_ordinals_.assign(layout.block_last_ordinals, layout.block_last_ordinals + block_count);
+    block_max_weights_.assign(layout.block_max_weights, layout.block_max_weights + block_count);
+    block_offsets_.assign(layout.block_offsets, layout.block_offsets + block_count + 1);
+    block_formats_.assign(layout.block_formats, layout.block_formats + block_count);
+    data_.assign(layout.data, layout.data + layout.block_offsets[block_count]);
+    owner_.reset();
+    Refresh();
+}
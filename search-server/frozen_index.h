@@ -0,0 +1,233 @@
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+#include "snapshot_io.h"
+
+//количество постингов в блоке сжатого списка
+const size_t POSTING_BLOCK_SIZE = 128;
+
+//постинг для сжатия: внутренний номер документа, число вхождений слова и вес постинга (TF),
+//по наибольшему весу блока поиск оценивает сверху вклад всех документов блока
+struct FrozenPosting {
+    int ordinal = 0;
+    uint32_t count = 0;
+    double weight = 0.0;
+};
+
+//замороженный индекс: списки постингов всех слов сжаты блоками по POSTING_BLOCK_SIZE постингов.
+//в блоке лежат разности соседних внутренних номеров документов и числа вхождений слова,
+//каждое поле блока занимает 1, 2 или 4 байта — сколько нужно наибольшему значению блока.
+//для каждого блока хранится последний номер документа и наибольший вес постинга (Block-Max):
+//по ним блоки пропускаются без распаковки.
+//на постинг обычно приходится 2 байта вместо 12 (int + double).
+//TF не квантуется: хранится целое число вхождений, а вес восстанавливается умножением на обратную длину
+//документа, поэтому сжатие без потерь и релевантность совпадает с несжатым индексом.
+//распаковка векторизована только на SSE2, без отдельных путей SSE4/AVX2.
+//массивы либо принадлежат индексу, либо подключены из отображенного в память снимка
+class FrozenIndex {
+public:
+    //блок, в котором мог бы лежать документ: наибольший вес постинга и последний номер документа блока
+    struct BlockBound {
+        double max_weight = 0.0;
+        int last_ordinal = 0;
+    };
+
+    //курсор по списку постингов слота: распаковывает по одному блоку и умеет переходить
+    //к первому постингу с номером не меньше заданного, пропуская блоки без распаковки
+    class Cursor {
+    public:
+        Cursor(const FrozenIndex &index, size_t slot);
+
+        bool IsEnd() const;
+        int GetOrdinal() const;
+        uint32_t GetCount() const;
+        //метод переходит к следующему постингу
+        void Next();
+        //метод переходит к первому постингу с номером документа не меньше ordinal
+        void Seek(int ordinal);
+        //метод находит, не распаковывая и не сдвигая курсор, блок, в котором лежал бы документ ordinal.
+        //за последним блоком граница нулевая до конца номеров
+        BlockBound PeekBlock(int ordinal) const;
+
+    private:
+        const FrozenIndex *index_;
+        size_t slot_;
+        uint64_t block_;
+        uint64_t end_block_;
+        size_t position_ = 0;
+        size_t count_ = 0;
+        int ordinals_[POSTING_BLOCK_SIZE];
+        uint32_t counts_[POSTING_BLOCK_SIZE];
+
+        //метод распаковывает блок, за последним блоком курсор встает в конец
+        void LoadBlock(uint64_t block);
+    };
+
+    //layout_ указывает в собственные массивы, поэтому копирование и перемещение перенаправляют его
+    FrozenIndex();
+    FrozenIndex(const FrozenIndex &other);
+    FrozenIndex &operator=(const FrozenIndex &other);
+    FrozenIndex(FrozenIndex &&other) noexcept;
+    FrozenIndex &operator=(FrozenIndex &&other) noexcept;
+
+    //метод добавляет список постингов очередного слова по возрастанию номеров документов, возвращает номер слота
+    size_t AddPostings(const std::vector<FrozenPosting> &postings);
+    //метод добавляет слотом список постингов слота другого индекса, блоки копируются без распаковки
+    size_t AddPostings(const FrozenIndex &source, size_t slot);
+
+    //метод обходит постинги слота с номерами документов из [first_ordinal, last_ordinal),
+    //блоки, целиком лежащие до first_ordinal, пропускаются без распаковки
+    template <typename Function>
+    void ForEach(size_t slot, int first_ordinal, int last_ordinal, Function function) const;
+
+    //метод проверяет наличие документа в списке постингов слота, распаковывается один блок
+    bool Contains(size_t slot, int ordinal) const;
+
+    //метод возвращает количество постингов слота
+    size_t GetPostingCount(size_t slot) const;
+
+    //метод возвращает наибольший вес постинга слота по границам его блоков
+    double GetMaxWeight(size_t slot) const;
+
+    //метод возвращает количество слотов
+    size_t GetSlotCount() const;
+
+    //метод возвращает общее количество постингов
+    size_t GetPostingCount() const;
+
+    //метод освобождает память индекса
+    void Clear();
+
+    //метод пишет сжатые списки в снимок
+    void Save(SnapshotWriter &writer) const;
+
+    //метод подключает сжатые списки из снимка без копирования, owner удерживает память снимка.
+    //разметка и все блоки проверяются при подключении: номера документов должны быть меньше ordinal_count,
+    //иначе бросается runtime_error
+    void Attach(SnapshotReader &reader, int ordinal_count, std::shared_ptr<const void> owner);
+
+private:
+    //указатели на массивы индекса, собственные или подключенные
+    struct Layout {
+        //накопленные количества постингов и блоков по слотам, slot_count + 1 значений
+        const uint64_t *slot_postings = nullptr;
+        const uint64_t *slot_blocks = nullptr;
+        //последний номер документа, наибольший вес, смещение в data и формат каждого блока
+        const int32_t *block_last_ordinals = nullptr;
+        const double *block_max_weights = nullptr;
+        const uint64_t *block_offsets = nullptr;
+        const uint8_t *block_formats = nullptr;
+        const uint8_t *data = nullptr;
+        size_t slot_count = 0;
+    };
+
+    std::vector<uint64_t> slot_postings_ = {0};
+    std::vector<uint64_t> slot_blocks_ = {0};
+    std::vector<int32_t> block_last_ordinals_;
+    std::vector<double> block_max_weights_;
+    std::vector<uint64_t> block_offsets_ = {0};
+    std::vector<uint8_t> block_formats_;
+    std::vector<uint8_t> data_;
+    Layout layout_;
+    //владелец подключенных массивов, пока он не пуст, layout_ указывает в снимок
+    std::shared_ptr<const void> owner_;
+
+    //метод распаковывает блок слота, возвращает количество постингов в нем
+    size_t DecodeBlock(size_t slot, size_t block, int *ordinals, uint32_t *counts) const;
+    //метод направляет layout_ на собственные массивы
+    void Refresh();
+    //метод обменивает содержимое индексов
+    void Swap(FrozenIndex &other) noexcept;
+    //метод копирует подключенные массивы в память индекса
+    void Materialize();
+};
+
+template <typename Function>
+void FrozenIndex::ForEach(size_t slot, int first_ordinal, int last_ordinal, Function function) const {
+    const uint64_t begin_block = layout_.slot_blocks[slot];
+    const uint64_t end_block = layout_.slot_blocks[slot + 1];
+    const int32_t *last_ordinals = layout_.block_last_ordinals;
+    int ordinals[POSTING_BLOCK_SIZE];
+    uint32_t counts[POSTING_BLOCK_SIZE];
+    for (uint64_t block = std::lower_bound(last_ordinals + begin_block, last_ordinals + end_block, first_ordinal) - last_ordinals;
+         block < end_block; ++block) {
+        if (block > begin_block && last_ordinals[block - 1] >= last_ordinal - 1) {
+            return;
+        }
+        const size_t count = DecodeBlock(slot, block, ordinals, counts);
+        for (size_t i = 0; i < count; ++i) {
+            if (ordinals[i] >= last_ordinal) {
+                return;
+            }
+            if (ordinals[i] >= first_ordinal) {
+                function(ordinals[i], counts[i]);
+            }
+        }
+    }
+}
+
+inline FrozenIndex::Cursor::Cursor(const FrozenIndex &index, size_t slot)
+        : index_(&index), slot_(slot), block_(index.layout_.slot_blocks[slot]), end_block_(index.layout_.slot_blocks[slot + 1]) {
+    LoadBlock(block_);
+}
+
+inline bool FrozenIndex::Cursor::IsEnd() const {
+    return block_ == end_block_;
+}
+
+inline int FrozenIndex::Cursor::GetOrdinal() const {
+    return ordinals_[position_];
+}
+
+inline uint32_t FrozenIndex::Cursor::GetCount() const {
+    return counts_[position_];
+}
+
+//метод переходит к следующему постингу
+inline void FrozenIndex::Cursor::Next() {
+    if (++position_ == count_) {
+        LoadBlock(block_ + 1);
+    }
+}
+
+//метод переходит к первому постингу с номером документа не меньше ordinal
+inline void FrozenIndex::Cursor::Seek(int ordinal) {
+    if (IsEnd() || ordinals_[position_] >= ordinal) {
+        return;
+    }
+    const int32_t *last_ordinals = index_->layout_.block_last_ordinals;
+    if (last_ordinals[block_] < ordinal) {
+        LoadBlock(std::lower_bound(last_ordinals + block_ + 1, last_ordinals + end_block_, ordinal) - last_ordinals);
+        if (IsEnd()) {
+            return;
+        }
+    }
+    position_ = std::lower_bound(ordinals_ + position_, ordinals_ + count_, ordinal) - ordinals_;
+}
+
+//метод находит, не распаковывая и не сдвигая курсор, блок, в котором лежал бы документ ordinal
+inline FrozenIndex::BlockBound FrozenIndex::Cursor::PeekBlock(int ordinal) const {
+    const int32_t *last_ordinals = index_->layout_.block_last_ordinals;
+    uint64_t block = block_;
+    if (block < end_block_ && last_ordinals[block] < ordinal) {
+        block = std::lower_bound(last_ordinals + block + 1, last_ordinals + end_block_, ordinal) - last_ordinals;
+    }
+    if (block == end_block_) {
+        return {0.0, std::numeric_limits<int>::max()};
+    }
+    return {index_->layout_.block_max_weights[block], last_ordinals[block]};
+}
+
+//метод распаковывает блок, за последним блоком курсор встает в конец
+inline void FrozenIndex::Cursor::LoadBlock(uint64_t block) {
+    block_ = block;
+    position_ = 0;
+    count_ = block < end_block_ ? index_->DecodeBlock(slot_, block, ordinals_, counts_) : 0;
+}
@@ -1,5 +1,6 @@
 #include "process_queries.h"
 #include "search_server.h"
+#include "test_example_functions.h"
 #include <execution>
 #include <iostream>
 #include <string>
@@ -15,6 +16,7 @@ void PrintDocument(const Document &document) {
 }
 
 int main() {
+    TestSearchServer();
     SearchServer search_server("and with"s);
     int id = 0;
     for (
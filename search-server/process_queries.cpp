@@ -1,4 +1,3 @@
-#include <list>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -7,38 +6,92 @@
 #include <functional>
 
 #include "process_queries.h"
+#include "thread_pool.h"
 
 //метод распаралеливания нескольких запросов к серверу
 std::vector <std::vector<Document>> ProcessQueries(
         const SearchServer &search_server,
-        const std::vector <std::string> &queries) {
+        const std::vector <std::string> &queries,
+        QueryBatchMode mode) {
+    //запросы передаются пулу сервера представлениями, строки не копируются
+    const std::vector <std::string_view> query_views(queries.begin(), queries.end());
+    return ProcessQueries(search_server, query_views, mode);
+}
 
-    // Вектор с заранее созданным размером
-    std::vector <std::vector<Document>> result(queries.size());
+//метод распаралеливания нескольких запросов к серверу без копирования текстов запросов
+std::vector <std::vector<Document>> ProcessQueries(
+        const SearchServer &search_server,
+        const std::vector <std::string_view> &queries,
+        QueryBatchMode mode) {
+    if (mode == QueryBatchMode::SHARED_TERMS) {
+        return search_server.FindTopDocumentsBatchByTerms(queries);
+    }
+    return search_server.FindTopDocumentsBatch(queries);
+}
 
-    // Подсчитываем функцией transform количество искомых слов
-    // при этом используем execution::par, для распаралеливания запроса
-    transform(std::execution::par, queries.begin(), queries.end(), result.begin(),
-              [&search_server](std::string query_find) {
-                  return search_server.FindTopDocuments(query_find);
-              });
+//метод дописывает результат очередного запроса
+void JoinedDocuments::Append(const std::vector<Document> &documents) {
+    documents_.insert(documents_.end(), documents.begin(), documents.end());
+    offsets_.push_back(documents_.size());
+}
 
-    return result;
+size_t JoinedDocuments::GetQueryCount() const {
+    return offsets_.size() - 1;
+}
+
+//метод возвращает документы запроса с номером index
+IteratorRange<std::vector<Document>::const_iterator> JoinedDocuments::GetQueryDocuments(size_t index) const {
+    return {documents_.begin() + offsets_.at(index), documents_.begin() + offsets_.at(index + 1)};
+}
+
+std::vector<Document>::const_iterator JoinedDocuments::begin() const {
+    return documents_.begin();
+}
+
+std::vector<Document>::const_iterator JoinedDocuments::end() const {
+    return documents_.end();
+}
+
+size_t JoinedDocuments::size() const {
+    return documents_.size();
 }
 
 //метод распаралеливания нескольких запросов к серверу
-//возвращает плоский набор документов
-std::list <Document> ProcessQueriesJoined(
+//возвращает документы всех запросов в одном буфере
+JoinedDocuments ProcessQueriesJoined(
         const SearchServer &search_server,
         const std::vector <std::string> &queries) {
+    const std::vector <std::string_view> query_views(queries.begin(), queries.end());
+    //результаты запросов дописываются в буфер по порядку, как только готовы, без промежуточного вектора векторов
+    JoinedDocuments result;
+    search_server.FindTopDocumentsBatchStreamed(query_views, [&result](size_t /*index*/, std::vector<Document> &&documents) {
+        result.Append(documents);
+    });
+    return result;
+}
 
-    // Cуммарный размер внутренних векторов FindTopDocuments
-    auto matched_docs = ProcessQueries(search_server, queries);
-
-    std::list <Document> result;
-    for (auto &query_res: matched_docs) {
-        result.insert(result.end(), query_res.begin(), query_res.end());
-    }
 
+//метод распаралеливания нескольких запросов к серверу с изоляцией читателей
+std::vector <std::vector<Document>> ProcessQueries(
+        const VersionedSearchServer &search_server,
+        const std::vector <std::string> &queries) {
+    //все запросы выполняются по одному снимку, поэтому видят одну и ту же версию
+    const auto view = search_server.GetView();
+    std::vector <std::vector<Document>> result(queries.size());
+    ThreadPool::GetDefault().ParallelFor(queries.size(), [&view, &queries, &result](size_t index) {
+        result[index] = view.FindTopDocuments(queries[index]);
+    });
     return result;
 }
+
+//метод распаралеливания нескольких запросов к серверу с изоляцией читателей
+//возвращает документы всех запросов в одном буфере
+JoinedDocuments ProcessQueriesJoined(
+        const VersionedSearchServer &search_server,
+        const std::vector <std::string> &queries) {
+    JoinedDocuments result;
+    for (const std::vector<Document> &documents : ProcessQueries(search_server, queries)) {
+        result.Append(documents);
+    }
+    return result;
+}
\ No newline at end of file
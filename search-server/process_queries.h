@@ -1,17 +1,94 @@
 #pragma once
 
-#include <list>
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <string_view>
 #include "document.h"
+#include "paginator.h"
 #include "search_server.h"
+#include "versioned_search_server.h"
+
+//способ выполнения пакета запросов
+enum class QueryBatchMode {
+    //каждый запрос ищется отдельно
+    INDEPENDENT,
+    //запросы пакета группируются по словам, и постинги каждого слова читаются один раз для всех запросов
+    SHARED_TERMS,
+};
+
+//результаты пакета запросов в одном непрерывном буфере: документы запроса i лежат
+//в [offsets[i], offsets[i + 1]). обход всего объекта дает документы всех запросов подряд
+class JoinedDocuments {
+public:
+    //метод дописывает результат очередного запроса
+    void Append(const std::vector<Document> &documents);
+
+    size_t GetQueryCount() const;
+    //метод возвращает документы запроса с номером index
+    IteratorRange<std::vector<Document>::const_iterator> GetQueryDocuments(size_t index) const;
+
+    std::vector<Document>::const_iterator begin() const;
+    std::vector<Document>::const_iterator end() const;
+    size_t size() const;
+
+private:
+    std::vector<Document> documents_;
+    std::vector<size_t> offsets_ = {0};
+};
 
 //метод распаралеливания нескольких запросов к серверу
 std::vector <std::vector<Document>> ProcessQueries(
+        const SearchServer &search_server,
+        const std::vector <std::string> &queries,
+        QueryBatchMode mode = QueryBatchMode::INDEPENDENT);
+
+//метод распаралеливания нескольких запросов к серверу без копирования текстов запросов:
+//запросы выполняются на пуле потоков сервера, тяжелые запросы делятся между потоками
+std::vector <std::vector<Document>> ProcessQueries(
+        const SearchServer &search_server,
+        const std::vector <std::string_view> &queries,
+        QueryBatchMode mode = QueryBatchMode::INDEPENDENT);
+
+//метод распаралеливания нескольких запросов к серверу
+//возвращает документы всех запросов в одном буфере, результаты запросов дописываются по мере готовности
+JoinedDocuments ProcessQueriesJoined(
         const SearchServer &search_server,
         const std::vector <std::string> &queries);
 
+//метод распаралеливания нескольких запросов к серверу с передачей результатов по готовности:
+//callback(index, std::vector<Document>&&) вызывается для каждого запроса, как только он (а при
+//QUERY_ORDER и все запросы до него) выполнен. вызовы callback не пересекаются по времени
+template <typename Callback>
+void ProcessQueriesStreamed(
+        const SearchServer &search_server,
+        const std::vector <std::string_view> &queries,
+        Callback callback,
+        QueryResultOrder order = QueryResultOrder::QUERY_ORDER) {
+    search_server.FindTopDocumentsBatchStreamed(queries, callback, order);
+}
+
 //метод распаралеливания нескольких запросов к серверу
-//возвращает плоский набор документов
-std::list <Document> ProcessQueriesJoined(
+//пишет документы всех запросов по порядку запросов в out по мере готовности и возвращает итератор за последним
+template <typename OutputIterator>
+OutputIterator ProcessQueriesJoined(
         const SearchServer &search_server,
+        const std::vector <std::string_view> &queries,
+        OutputIterator out) {
+    search_server.FindTopDocumentsBatchStreamed(queries, [&out](size_t index, std::vector<Document> &&documents) {
+        out = std::move(documents.begin(), documents.end(), out);
+    });
+    return out;
+}
+
+//метод распаралеливания нескольких запросов к серверу с изоляцией читателей:
+//все запросы выполняются по одному снимку и видят одну и ту же версию индекса
+std::vector <std::vector<Document>> ProcessQueries(
+        const VersionedSearchServer &search_server,
+        const std::vector <std::string> &queries);
+
+//метод распаралеливания нескольких запросов к серверу с изоляцией читателей
+//возвращает документы всех запросов в одном буфере
+JoinedDocuments ProcessQueriesJoined(
+        const VersionedSearchServer &search_server,
         const std::vector <std::string> &queries);
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "query_result_cache.h"
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(const QueryResultCache &other) {
+    SetCapacity(other.capacity_);
+}
+
+QueryResultCache &QueryResultCache::operator=(const QueryResultCache &other) {
+    if (this != &other) {
+        SetCapacity(other.capacity_);
+    }
+    return *this;
+}
+
+//метод задает общее количество записей и очищает кэш
+void QueryResultCache::SetCapacity(size_t capacity) {
+    capacity_ = capacity;
+    shard_capacity_ = (capacity + QUERY_CACHE_SHARD_COUNT - 1) / QUERY_CACHE_SHARD_COUNT;
+    shards_ = capacity == 0 ? nullptr : make_unique<Shard[]>(QUERY_CACHE_SHARD_COUNT);
+    hits_ = 0;
+    misses_ = 0;
+}
+
+size_t QueryResultCache::GetCapacity() const {
+    return capacity_;
+}
+
+//метод возвращает документы, посчитанные на версии индекса version, или nullopt
+optional<vector<Document>> QueryResultCache::Find(const QueryCacheKey &key, uint64_t version) {
+    if (!shards_) {
+        return nullopt;
+    }
+    const size_t hash = KeyHash{}(key);
+    Shard &shard = GetShard(hash);
+    {
+        lock_guard guard(shard.mutex);
+        const auto it = shard.positions.find(key);
+        if (it != shard.positions.end()) {
+            if (it->second->version == version) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+                hits_.fetch_add(1, memory_order_relaxed);
+                return it->second->documents;
+            }
+            //запись посчитана до изменения индекса
+            shard.entries.erase(it->second);
+            shard.positions.erase(it);
+        }
+    }
+    misses_.fetch_add(1, memory_order_relaxed);
+    return nullopt;
+}
+
+//метод запоминает результат запроса, вытесняя самую давнюю запись части
+void QueryResultCache::Insert(QueryCacheKey key, uint64_t version, vector<Document> documents) {
+    if (!shards_) {
+        return;
+    }
+    Shard &shard = GetShard(KeyHash{}(key));
+    lock_guard guard(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it != shard.positions.end()) {
+        //тот же запрос мог посчитать параллельный поток
+        it->second->version = version;
+        it->second->documents = move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    shard.entries.push_front({key, version, move(documents)});
+    shard.positions.emplace(move(key), shard.entries.begin());
+    if (shard.entries.size() > shard_capacity_) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+}
+
+QueryCacheStats QueryResultCache::GetStats() const {
+    return {hits_.load(memory_order_relaxed), misses_.load(memory_order_relaxed)};
+}
+
+size_t QueryResultCache::KeyHash::operator()(const QueryCacheKey &key) const {
+    uint64_t hash = key.plus_word_count * 0x9E3779B97F4A7C15ull;
+    hash = (hash ^ (static_cast<uint64_t>(key.status) << 32 | key.max_count)) * 0xBF58476D1CE4E5B9ull;
+    for (const TermId term : key.terms) {
+        hash = (hash ^ term) * 0x94D049BB133111EBull;
+        hash ^= hash >> 29;
+    }
+    return static_cast<size_t>(hash);
+}
+
+QueryResultCache::Shard &QueryResultCache::GetShard(size_t hash) {
+    return shards_[hash % QUERY_CACHE_SHARD_COUNT];
+}
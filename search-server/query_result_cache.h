@@ -0,0 +1,86 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+#include "document.h"
+#include "term_dictionary.h"
+
+//количество независимых частей кэша, у каждой своя блокировка
+const size_t QUERY_CACHE_SHARD_COUNT = 16;
+
+//ключ кэша: id плюс-слов, затем id минус-слов разобранного запроса (каждая группа по возрастанию),
+//статус документов и размер топа
+struct QueryCacheKey {
+    std::vector<TermId> terms;
+    size_t plus_word_count = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    size_t max_count = 0;
+
+    bool operator==(const QueryCacheKey &other) const {
+        return plus_word_count == other.plus_word_count && status == other.status
+               && max_count == other.max_count && terms == other.terms;
+    }
+};
+
+//счетчики обращений к кэшу
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+//кэш результатов запросов: LRU, разделенный на QUERY_CACHE_SHARD_COUNT частей по хэшу ключа,
+//поэтому параллельные запросы редко ждут друг друга. запись помнит версию индекса, на которой
+//она посчитана, и устаревшая запись считается промахом. нулевая емкость выключает кэш
+class QueryResultCache {
+public:
+    QueryResultCache() = default;
+
+    //копия сервера начинает с пустым кэшем той же емкости
+    QueryResultCache(const QueryResultCache &other);
+    QueryResultCache &operator=(const QueryResultCache &other);
+
+    //метод задает общее количество записей и очищает кэш
+    void SetCapacity(size_t capacity);
+    size_t GetCapacity() const;
+
+    //метод возвращает документы, посчитанные на версии индекса version, или nullopt
+    std::optional<std::vector<Document>> Find(const QueryCacheKey &key, uint64_t version);
+    //метод запоминает результат запроса, вытесняя самую давнюю запись части
+    void Insert(QueryCacheKey key, uint64_t version, std::vector<Document> documents);
+
+    QueryCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        QueryCacheKey key;
+        uint64_t version = 0;
+        std::vector<Document> documents;
+    };
+
+    struct KeyHash {
+        size_t operator()(const QueryCacheKey &key) const;
+    };
+
+    //часть кэша: записи от недавних к давним и их положения по ключам
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries;
+        std::unordered_map<QueryCacheKey, std::list<Entry>::iterator, KeyHash> positions;
+    };
+
+    size_t capacity_ = 0;
+    size_t shard_capacity_ = 0;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard &GetShard(size_t hash);
+};
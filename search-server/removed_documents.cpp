@@ -0,0 +1,40 @@
+#include "removed_documents.h"
+
+using namespace std;
+
+//метод добавляет документы сервера: номера отмечаются в битовой карте, слова документов — в поправках частоты
+void RemovedDocuments::Add(const SearchServer &server, const vector<int> &document_ids) {
+    vector<int> added_ids;
+    for (const int document_id : document_ids) {
+        if (server.HasDocument(document_id) && document_ids_.insert(document_id).second) {
+            added_ids.push_back(document_id);
+        }
+    }
+    server.MarkDocuments(added_ids, documents_);
+    for (const int document_id : added_ids) {
+        for (const auto &[word, term_freq] : server.GetWordFrequencies(document_id)) {
+            ++document_freqs_[word];
+        }
+    }
+}
+
+//метод проверяет, удален ли документ
+bool RemovedDocuments::Contains(int document_id) const {
+    return document_ids_.count(document_id) > 0;
+}
+
+//метод возвращает количество удаленных документов
+int RemovedDocuments::GetCount() const {
+    return static_cast<int>(document_ids_.size());
+}
+
+//метод возвращает id удаленных документов по возрастанию
+const set<int> &RemovedDocuments::GetDocumentIds() const {
+    return document_ids_;
+}
+
+//метод возвращает количество удаленных документов со словом
+int RemovedDocuments::GetDocumentFrequency(string_view word) const {
+    const auto it = document_freqs_.find(word);
+    return it == document_freqs_.end() ? 0 : it->second;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+#include "search_server.h"
+#include "document_bitmap.h"
+
+//документы неизменяемого сервера, удаленные после его сборки. поправки для поиска считаются при удалении:
+//битовая карта внутренних номеров удаленных документов и количество удаленных документов с каждым словом,
+//поэтому запрос не обходит удаленные документы. сам сервер не изменяется: удаления копируются при записи,
+//а версии без новых удалений делят одни и те же. удаления относятся к одному серверу и живут не дольше его
+class RemovedDocuments {
+public:
+    //метод добавляет документы сервера с id из document_ids, неизвестные и уже удаленные id пропускаются
+    void Add(const SearchServer &server, const std::vector<int> &document_ids);
+
+    //метод проверяет, удален ли документ
+    bool Contains(int document_id) const;
+    //метод возвращает количество удаленных документов
+    int GetCount() const;
+    //метод возвращает id удаленных документов по возрастанию
+    const std::set<int> &GetDocumentIds() const;
+    //метод возвращает количество удаленных документов со словом
+    int GetDocumentFrequency(std::string_view word) const;
+
+    //метод возвращает фильтр поиска по серверу, пропускающий удаленные документы по битовой карте
+    template <typename DocumentPredicate>
+    ExcludingDocumentsFilter<DocumentPredicate> MakeFilter(DocumentPredicate document_predicate) const {
+        return {document_predicate, &documents_};
+    }
+
+private:
+    std::set<int> document_ids_;
+    //внутренние номера удаленных документов в сервере
+    DocumentBitmap documents_;
+    //слова указывают в словарь сервера
+    std::map<std::string_view, int, std::less<>> document_freqs_;
+};
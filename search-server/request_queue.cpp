@@ -5,21 +5,21 @@ using namespace std;
 //метод добавления запроса с лямбдой, для сохранения статистики
 template<typename DocumentPredicate>
 vector <Document> RequestQueue::AddFindRequest(const string &raw_query, DocumentPredicate document_predicate) {
-    const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
+    const auto result = FindTopDocuments(raw_query, document_predicate);
     AddRequest(result.size());
     return result;
 }
 
 //метод добавления запроса с заданным статусом, для сохранения статистики
 vector <Document> RequestQueue::AddFindRequest(const string &raw_query, DocumentStatus status) {
-    const auto result = search_server_.FindTopDocuments(raw_query, status);
+    const auto result = FindTopDocuments(raw_query, status);
     AddRequest(result.size());
     return result;
 }
 
 //метод добавления запроса с актуальным статусом, для сохранения статистики
 vector <Document> RequestQueue::AddFindRequest(const string &raw_query) {
-    const auto result = search_server_.FindTopDocuments(raw_query);
+    const auto result = FindTopDocuments(raw_query);
     AddRequest(result.size());
     return result;
 }
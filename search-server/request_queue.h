@@ -5,11 +5,17 @@
 #include <string>
 #include <iostream>
 #include "search_server.h"
+#include "versioned_search_server.h"
 
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer &search_server)
-            : search_server_(search_server), no_results_requests_(0), current_time_(0) {
+            : search_server_(&search_server), no_results_requests_(0), current_time_(0) {
+    }
+
+    //каждый запрос к серверу с изоляцией читателей выполняется по его текущему снимку
+    explicit RequestQueue(const VersionedSearchServer &search_server)
+            : versioned_search_server_(&search_server), no_results_requests_(0), current_time_(0) {
     }
 
     //метод добавления запроса с лямбдой, для сохранения статистики
@@ -32,10 +38,21 @@ private:
     };
 
     std::deque <QueryResult> requests_;
-    const SearchServer &search_server_;
+    const SearchServer *search_server_ = nullptr;
+    const VersionedSearchServer *versioned_search_server_ = nullptr;
     int no_results_requests_;
     uint64_t current_time_;
     const static int min_in_day_ = 1440;
 
     void AddRequest(int results_num);
+
+    //метод выполняет поиск по серверу, у сервера с изоляцией читателей — по снимку текущей версии
+    template<typename... Args>
+    std::vector <Document> FindTopDocuments(const Args &... args) const {
+        if (versioned_search_server_) {
+            const auto view = versioned_search_server_->GetView();
+            return view.FindTopDocuments(args...);
+        }
+        return search_server_->FindTopDocuments(args...);
+    }
 };
\ No newline at end of file
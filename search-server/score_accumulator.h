@@ -0,0 +1,159 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+//плоский накопитель релевантности запроса: массив счетов по внутренним номерам документов
+//и список затронутых документов, по которому накопитель обходится и очищается.
+//накопитель покрывает отрезок номеров [first_ordinal, first_ordinal + document_count),
+//поэтому потоки параллельного поиска копят каждый свой отрезок без блокировок
+class ScoreAccumulator {
+public:
+    //метод готовит накопитель к запросу по document_count документам начиная с first_ordinal
+    void Prepare(size_t document_count, int first_ordinal) {
+        first_ordinal_ = first_ordinal;
+        if (scores_.size() < document_count) {
+            scores_.resize(document_count, 0.0);
+            states_.resize(document_count, UNTOUCHED);
+        }
+    }
+
+    //метод добавляет вклад слова в релевантность документа, исключенные документы пропускаются
+    void Add(int ordinal, double score) {
+        const int index = ordinal - first_ordinal_;
+        if (states_[index] == UNTOUCHED) {
+            states_[index] = SCORED;
+            touched_.push_back(index);
+        }
+        if (states_[index] == SCORED) {
+            scores_[index] += score;
+        }
+    }
+
+    //метод исключает документ из результата (минус-слово)
+    void Exclude(int ordinal) {
+        const int index = ordinal - first_ordinal_;
+        if (states_[index] == UNTOUCHED) {
+            touched_.push_back(index);
+        }
+        states_[index] = EXCLUDED;
+    }
+
+    //метод возвращает количество затронутых документов
+    size_t GetTouchedCount() const {
+        return touched_.size();
+    }
+
+    //метод обходит документы с накопленной релевантностью среди затронутых с номерами [first, last)
+    template <typename Function>
+    void ForEach(size_t first, size_t last, Function function) const {
+        for (size_t i = first; i < last; ++i) {
+            const int index = touched_[i];
+            if (states_[index] == SCORED) {
+                function(first_ordinal_ + index, scores_[index]);
+            }
+        }
+    }
+
+    //метод обходит все документы с накопленной релевантностью
+    template <typename Function>
+    void ForEach(Function function) const {
+        ForEach(0, touched_.size(), function);
+    }
+
+    //метод очищает только затронутые ячейки, память остается для следующего запроса
+    void Clear() {
+        for (const int index: touched_) {
+            scores_[index] = 0.0;
+            states_[index] = UNTOUCHED;
+        }
+        touched_.clear();
+    }
+
+private:
+    enum State : uint8_t {
+        UNTOUCHED,
+        SCORED,
+        EXCLUDED,
+    };
+
+    int first_ordinal_ = 0;
+    std::vector<double> scores_;
+    std::vector<State> states_;
+    //номера затронутых ячеек относительно first_ordinal_
+    std::vector<int> touched_;
+};
+
+//пул накопителей: запросы берут готовый накопитель и возвращают его,
+//поэтому в установившемся режиме поиск не выделяет память под счета
+class ScoreAccumulatorPool {
+public:
+    //владеющая ссылка на накопитель, при разрушении очищает его и возвращает в пул
+    class Handle {
+    public:
+        Handle(ScoreAccumulatorPool &pool, std::unique_ptr<ScoreAccumulator> accumulator)
+                : pool_(&pool), accumulator_(std::move(accumulator)) {
+        }
+
+        Handle(Handle &&other) = default;
+        Handle &operator=(Handle &&other) = delete;
+
+        ~Handle() {
+            if (accumulator_) {
+                accumulator_->Clear();
+                pool_->Return(std::move(accumulator_));
+            }
+        }
+
+        ScoreAccumulator &operator*() const {
+            return *accumulator_;
+        }
+
+        ScoreAccumulator *operator->() const {
+            return accumulator_.get();
+        }
+
+    private:
+        ScoreAccumulatorPool *pool_;
+        std::unique_ptr<ScoreAccumulator> accumulator_;
+    };
+
+    ScoreAccumulatorPool() = default;
+
+    //копия сервера начинает с пустым пулом
+    ScoreAccumulatorPool(const ScoreAccumulatorPool &) {
+    }
+
+    ScoreAccumulatorPool &operator=(const ScoreAccumulatorPool &) {
+        return *this;
+    }
+
+    //метод выдает накопитель, готовый к запросу по document_count документам начиная с first_ordinal
+    Handle Acquire(size_t document_count, int first_ordinal = 0) {
+        std::unique_ptr<ScoreAccumulator> accumulator;
+        {
+            std::lock_guard guard(mutex_);
+            if (!free_.empty()) {
+                accumulator = std::move(free_.back());
+                free_.pop_back();
+            }
+        }
+        if (!accumulator) {
+            accumulator = std::make_unique<ScoreAccumulator>();
+        }
+        accumulator->Prepare(document_count, first_ordinal);
+        return Handle(*this, std::move(accumulator));
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ScoreAccumulator>> free_;
+
+    void Return(std::unique_ptr<ScoreAccumulator> accumulator) {
+        std::lock_guard guard(mutex_);
+        free_.push_back(std::move(accumulator));
+    }
+};
@@ -12,58 +12,121 @@ SearchServer::SearchServer(const string& stop_words_text)
         SplitIntoWords(stop_words_text)){
 }
 
+//копия сервера независима от исходного: частоты слов документов строятся заново по собственному словарю копии
+SearchServer::SearchServer(const SearchServer& other)
+        : document_id_(other.document_id_),
+          document_ordinals_(other.document_ordinals_),
+          ordinal_to_id_(other.ordinal_to_id_),
+          document_ratings_(other.document_ratings_),
+          document_statuses_(other.document_statuses_),
+          status_documents_(other.status_documents_),
+          status_document_counts_(other.status_document_counts_),
+          document_lengths_(other.document_lengths_),
+          inverse_document_lengths_(other.inverse_document_lengths_),
+          stop_words_(other.stop_words_),
+          stop_word_filter_(other.stop_word_filter_),
+          dictionary_(other.dictionary_),
+          forward_index_(other.forward_index_),
+          word_to_document_freqs_(other.word_to_document_freqs_),
+          max_term_freqs_(other.max_term_freqs_),
+          frozen_index_(other.frozen_index_),
+          frozen_ordinal_count_(other.frozen_ordinal_count_),
+          is_frozen_(other.is_frozen_),
+          accumulator_pool_(other.accumulator_pool_),
+          document_freqs_(other.document_freqs_),
+          log_document_count_(other.log_document_count_),
+          log_document_freqs_(other.log_document_freqs_),
+          dead_documents_(other.dead_documents_),
+          dead_ordinals_(other.dead_ordinals_),
+          use_tombstones_(other.use_tombstones_),
+          max_dead_ratio_(other.max_dead_ratio_),
+          index_version_(other.index_version_),
+          dictionary_generation_(other.dictionary_generation_),
+          query_cache_(other.query_cache_),
+          thread_pool_(other.thread_pool_) {
+}
+
 //метод добавления документов
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int> &ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id");
     }
-    deque_document_structure_.push_back(string(document));
-    const auto words = SplitIntoWordsNoStop(string_view(deque_document_structure_.back()));
-    const double inv_word_count = 1.0 / words.size();
+    vector<string_view> words;
+    SplitIntoWordsNoStop(document, words);
+    const double inv_word_count = ComputeInverseLength(words.size());
+    //каждое слово переводится в id словаря один раз, TF слова копится по его вхождениям
+    vector<TermId> terms;
+    terms.reserve(words.size());
     for (const auto& word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        word_freqs_[document_id][word] += inv_word_count;
+        terms.push_back(dictionary_.Intern(word));
+    }
+    sort(terms.begin(), terms.end());
+    vector<pair<TermId, double>> term_freqs;
+    for (const TermId term : terms) {
+        if (term_freqs.empty() || term_freqs.back().first != term) {
+            term_freqs.emplace_back(term, 0.0);
+        }
+        term_freqs.back().second += inv_word_count;
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    //новый документ получает следующий внутренний номер, его постинги дописываются в конец хвоста
+    const int ordinal = static_cast<int>(ordinal_to_id_.size());
+    if (!term_freqs.empty()) {
+        ReserveTerms(term_freqs.back().first + 1);
+    }
+    for (const auto& [term, term_freq] : term_freqs) {
+        word_to_document_freqs_[term].emplace_hint(word_to_document_freqs_[term].end(), ordinal, term_freq);
+        ChangeDocumentFreq(term, 1);
+        max_term_freqs_[term] = max(max_term_freqs_[term], term_freq);
+    }
+    forward_index_.AddDocument(term_freqs);
+    ordinal_to_id_.push_back(document_id);
+    dead_documents_.push_back(false);
+    document_ratings_.push_back(ComputeAverageRating(ratings));
+    AddDocumentStatus(status);
+    document_lengths_.push_back(static_cast<uint32_t>(words.size()));
+    inverse_document_lengths_.push_back(inv_word_count);
+    document_ordinals_.emplace(document_id, ordinal);
     document_id_.insert(document_id);
+    UpdateDocumentCount();
+}
+
+//метод проверяет, что документ можно добавить, не изменяя индекс
+void SearchServer::CheckNewDocument(int document_id, string_view document) const {
+    if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
+        throw std::invalid_argument("Invalid document_id");
+    }
+    SplitIntoWordsNoStop(document, GetQueryWordBuffer());
 }
 
 //метод поиска топ докуметов с заданным статусом
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](const int &document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
-    });
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(execution::seq, raw_query, status, max_count);
 }
 //метод поиска топ докуметов с актуальным статусом
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
-    return FindTopDocuments(raw_query, [](const int &document_id, DocumentStatus status, int rating) {
-        return status == DocumentStatus::ACTUAL;
-    });
+    return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
 //метод возвращает все плюс-слова запроса, содержащиеся в документе отсортированые по возрастанию.
 //если нет пересечений по плюс-словам или есть минус-слово, вектор слов возвращается пустым.
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(string_view raw_query, int document_id) const {
     const auto query = ParseQuery(raw_query);
+    const int ordinal = GetOrdinal(document_id);
     vector<string_view> matched_words;
-    for (const string_view word: query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { matched_words, documents_.at(document_id).status };
+    for (const TermId term: query.minus_words) {
+        if (HasPosting(term, ordinal)) {
+            return { matched_words, document_statuses_[ordinal] };
         }
     }
-    for (const string_view word: query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
+    for (const TermId term: query.plus_words) {
+        if (HasPosting(term, ordinal)) {
+            matched_words.push_back(dictionary_.GetWord(term));
         }
     }
+    //id слов упорядочены по времени появления, слова возвращаются по алфавиту
+    sort(matched_words.begin(), matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_statuses_[ordinal] };
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::sequenced_policy&, string_view raw_query, int document_id) const {
@@ -72,47 +135,77 @@ tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const exe
 
 //паралельный метод возвращает все плюс-слова запроса, содержащиеся в документе отсортированые по возрастанию.
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const execution::parallel_policy& policy, string_view raw_query, int document_id) const {
-    //добавляем флаг true, что бы вызвался паралельный метод ParseQuery
-    const auto query = ParseQuery(true, raw_query);
+    const auto query = ParseQuery(raw_query);
+    const int ordinal = GetOrdinal(document_id);
     //создаем вектор, с заранее подготовленным размером
     vector<string_view> matched_words;
 
     //проверка на совпадение по минус словам, возвращаем ноль, так как нет слов
-    if(any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&](auto& word){
-        if (word_to_document_freqs_.count(word)){
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                return true;
-            }
-        }
-        return false;
-    }) == true) return {matched_words, documents_.at(document_id).status};
+    if(any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&](TermId term){
+        return HasPosting(term, ordinal);
+    }) == true) return {matched_words, document_statuses_[ordinal]};
 
     //находим плюс слов
-    matched_words.resize(query.plus_words.size());
-    matched_words.clear();
-    auto end = copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](auto raw_word){
-        if (word_to_document_freqs_.count(raw_word) == 0) {
-            return false;
-        }
-        if (word_to_document_freqs_.at(raw_word).count(document_id)) {
-            return true;
-        }
-        return false;
+    vector<TermId> matched_terms(query.plus_words.size());
+    auto end = copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_terms.begin(), [&](TermId term){
+        return HasPosting(term, ordinal);
     });
 
     //сортируем вектор для метода unique
-    sort(matched_words.begin(), end);
-    //ищем все последовательно повторяющиеся плюс слова из диапазона query
-    auto it = unique(matched_words.begin(), end);
+    sort(matched_terms.begin(), end);
     //удаляем последовательно повторяющиеся плюс слова из диапазона query
-    matched_words.erase(it, matched_words.end());
+    matched_terms.erase(unique(matched_terms.begin(), end), matched_terms.end());
+
+    matched_words.reserve(matched_terms.size());
+    for (const TermId term : matched_terms) {
+        matched_words.push_back(dictionary_.GetWord(term));
+    }
+    sort(matched_words.begin(), matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, document_statuses_[ordinal] };
 }
 
 //метод возвращает количество документов в поисковой системе.
 int SearchServer::GetDocumentCount() const {
-    return static_cast<int>(documents_.size());
+    return static_cast<int>(document_ordinals_.size());
+}
+
+//метод проверяет, есть ли документ в поисковой системе
+bool SearchServer::HasDocument(int document_id) const {
+    return document_ordinals_.count(document_id) > 0;
+}
+
+//метод возвращает количество документов, содержащих слово, стоп-слова и неизвестные слова дают 0
+int SearchServer::GetDocumentFrequency(string_view word) const {
+    const TermId term = dictionary_.Find(word);
+    return term == TermDictionary::NO_TERM ? 0 : document_freqs_[term];
+}
+
+//метод разбирает запрос так же, как поиск, и возвращает его различные плюс-слова без стоп-слов по возрастанию
+vector<string_view> SearchServer::ParseQueryPlusWords(string_view raw_query) const {
+    auto& words = GetQueryWordBuffer();
+    const bool is_valid_text = SplitIntoWords(raw_query, words);
+    vector<string_view> plus_words;
+    for (const string_view word : words) {
+        const QueryWord query_word = ParseQueryWord(word, is_valid_text);
+        if (!query_word.is_minus && !query_word.is_stop) {
+            plus_words.push_back(query_word.data);
+        }
+    }
+    sort(plus_words.begin(), plus_words.end());
+    plus_words.erase(unique(plus_words.begin(), plus_words.end()), plus_words.end());
+    return plus_words;
+}
+
+//метод отмечает в битовой карте внутренние номера документов с заданными id
+void SearchServer::MarkDocuments(const vector<int>& document_ids, DocumentBitmap& documents) const {
+    documents.Resize(ordinal_to_id_.size());
+    for (const int document_id : document_ids) {
+        const auto it = document_ordinals_.find(document_id);
+        if (it != document_ordinals_.end()) {
+            documents.Set(it->second);
+        }
+    }
 }
 
 set<int>::const_iterator SearchServer::begin() const {
@@ -133,7 +226,7 @@ set<int>::iterator SearchServer::end() {
 
 //метод проверки на стоп слово
 bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_word_filter_.Contains(word);
 }
 
 //метод проверки на валидность слов
@@ -143,18 +236,16 @@ bool SearchServer::IsValidWord(string_view word) {
     });
 }
 
-//метод очищающий запрос от стоп слов
-vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
-    vector<string_view> words;
-    for (string_view word: SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw invalid_argument("Word " + string(word) + " is invalid");
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+//метод очищающий текст от стоп слов: слова пишутся в буфер words, проверка на валидность
+//идет за тот же проход, что и разбиение, и слова повторно просматриваются только при ошибке
+void SearchServer::SplitIntoWordsNoStop(string_view text, vector<string_view>& words) const {
+    if (!SplitIntoWords(text, words)) {
+        const auto invalid_word = find_if_not(words.begin(), words.end(), IsValidWord);
+        throw invalid_argument("Word " + string(*invalid_word) + " is invalid");
     }
-    return words;
+    words.erase(remove_if(words.begin(), words.end(), [this](string_view word) {
+        return IsStopWord(word);
+    }), words.end());
 }
 
 //метод расчитывающий рейтинг слов
@@ -166,8 +257,14 @@ int SearchServer::ComputeAverageRating(const vector<int> &ratings) {
     return rating_sum / static_cast<int>(ratings.size());
 }
 
+//метод возвращает обратную длину документа, у документа только из стоп-слов постингов нет и она 0
+double SearchServer::ComputeInverseLength(size_t word_count) {
+    return word_count == 0 ? 0.0 : 1.0 / static_cast<double>(word_count);
+}
+
 //метод позволяет опредлелить где минус а где плюс слова
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
+//is_valid_text сообщает, что разбиение уже проверило текст запроса на управляющие символы
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text, bool is_valid_text) const {
     if (text.size()==0) {
         throw std::invalid_argument("Query word is empty");
     }
@@ -176,121 +273,999 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
         is_minus = true;
         text = text.substr(1);
     }
-    if (text.size()==0 || text[0] == '-' || !IsValidWord(text)) {
+    if (text.size()==0 || text[0] == '-' || (!is_valid_text && !IsValidWord(text))) {
         throw std::invalid_argument("Query word " + std::string(text) + " is invalid");
     }
 
     return { text, is_minus, IsStopWord(text) };
 }
 
+//буфер слов разбираемого запроса, свой у каждого потока: разбор короткого запроса не выделяет память
+vector<string_view>& SearchServer::GetQueryWordBuffer() {
+    thread_local vector<string_view> words;
+    return words;
+}
+
+//буфер берется из пула потока, пустой пул дает новый буфер
+SearchServer::InverseDocumentFreqBuffer::InverseDocumentFreqBuffer() {
+    auto& pool = GetPool();
+    if (!pool.empty()) {
+        buffer_ = move(pool.back());
+        pool.pop_back();
+    }
+}
+
+//буфер возвращается в пул потока, в котором был взят: поиск не переходит между потоками
+SearchServer::InverseDocumentFreqBuffer::~InverseDocumentFreqBuffer() {
+    GetPool().push_back(move(buffer_));
+}
+
+vector<double>& SearchServer::InverseDocumentFreqBuffer::Get() {
+    return buffer_;
+}
+
+vector<vector<double>>& SearchServer::InverseDocumentFreqBuffer::GetPool() {
+    thread_local vector<vector<double>> pool;
+    return pool;
+}
+
 SearchServer::Query SearchServer::ParseQuery(string_view text) const {
     Query query;
+    auto& words = GetQueryWordBuffer();
+    const bool is_valid_text = SplitIntoWords(text, words);
     //итерируемся по отдельно сформированным словам
-    for (std::string_view word: SplitIntoWords(text)) {
+    for (std::string_view word: words) {
         //определяем слова на плюс и минус слова
-        auto query_word = ParseQueryWord(word);
-        //если в запросе не стоп слова, то разделям минус и плюс слова
-        if (!query_word.is_stop) {
+        auto query_word = ParseQueryWord(word, is_valid_text);
+        //если в запросе не стоп слова, то разделям минус и плюс слова.
+        //слова, которых нет в словаре, не влияют на результат и отбрасываются
+        const TermId term = query_word.is_stop ? TermDictionary::NO_TERM : dictionary_.Find(query_word.data);
+        if (term != TermDictionary::NO_TERM) {
             if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
+                query.minus_words.push_back(term);
             } else {
-                query.plus_words.push_back(query_word.data);
+                query.plus_words.push_back(term);
             }
         }
     }
+    RemoveDuplicateTerms(query.minus_words);
+    RemoveDuplicateTerms(query.plus_words);
+    return query;
+}
+
+//метод убирает повторы слов запроса, слова упорядочиваются по id
+void SearchServer::RemoveDuplicateTerms(QueryTerms& terms) {
     //сортируем вектор для метода unique
-    sort(query.minus_words.begin(), query.minus_words.end());
-    //ищем все последовательно повторяющиеся минус слова из диапазона query
-    auto last_m = unique(query.minus_words.begin(), query.minus_words.end());
-    //удаляем последовательно повторяющиеся минус слова из диапазона query
-    query.minus_words.erase(last_m, query.minus_words.end());
-    //сортируем вектор для метода unique
-    sort(query.plus_words.begin(), query.plus_words.end());
-    //ищем все последовательно повторяющиеся плюс слова из диапазона query
-    auto last_p = unique(query.plus_words.begin(), query.plus_words.end());
-    //удаляем последовательно повторяющиеся плюс слова из диапазона query
-    query.plus_words.erase(last_p, query.plus_words.end());
+    sort(terms.begin(), terms.end());
+    //удаляем последовательно повторяющиеся слова
+    terms.erase(unique(terms.begin(), terms.end()), terms.end());
+}
 
+//метод компилирует запрос для многократного выполнения
+SearchServer::CompiledQuery SearchServer::CompileQuery(string_view raw_query) const {
+    CompiledQuery compiled_query;
+    compiled_query.query_ = ParseQuery(raw_query);
+    compiled_query.dictionary_size_ = dictionary_.GetSize();
+    compiled_query.raw_query_ = raw_query;
+    compiled_query.dictionary_generation_ = dictionary_generation_;
+    //разбор уже проверил запрос, поэтому слова вне словаря выбираются без повторных проверок
+    for (const string_view word : GetQueryWordBuffer()) {
+        const QueryWord query_word = ParseQueryWord(word, true);
+        if (!query_word.is_stop && dictionary_.Find(query_word.data) == TermDictionary::NO_TERM) {
+            (query_word.is_minus ? compiled_query.unresolved_minus_words_ : compiled_query.unresolved_plus_words_).emplace_back(query_word.data);
+        }
+    }
+    return compiled_query;
+}
+
+//метод возвращает разобранный скомпилированный запрос, дополнив его словами, попавшими в словарь после компиляции.
+//после перенумерации слов запрос разбирается заново
+SearchServer::Query SearchServer::ResolveQuery(const CompiledQuery& compiled_query) const {
+    if (compiled_query.dictionary_generation_ != dictionary_generation_) {
+        return ParseQuery(compiled_query.raw_query_);
+    }
+    Query query = compiled_query.query_;
+    const auto resolve = [this](const vector<string>& words, QueryTerms& terms) {
+        for (const string& word : words) {
+            const TermId term = dictionary_.Find(word);
+            if (term != TermDictionary::NO_TERM) {
+                terms.push_back(term);
+            }
+        }
+        RemoveDuplicateTerms(terms);
+    };
+    resolve(compiled_query.unresolved_plus_words_, query.plus_words);
+    resolve(compiled_query.unresolved_minus_words_, query.minus_words);
     return query;
 }
 
+//метод поиска топ докуметов по скомпилированному запросу с заданным статусом
+vector<Document> SearchServer::FindTopDocuments(const CompiledQuery& query, DocumentStatus status, size_t max_count) const {
+    if (IsQueryResolved(query)) {
+        return FindTopDocumentsWithStatus(execution::seq, query.query_, status, max_count);
+    }
+    return FindTopDocumentsWithStatus(execution::seq, ResolveQuery(query), status, max_count);
+}
+
+//метод выполняет пакет запросов с заданным статусом на пуле потоков сервера
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string_view>& raw_queries, DocumentStatus status,
+                                                             size_t max_count) const {
+    const ThreadPool& pool = GetThreadPool();
+    vector<vector<Document>> results(raw_queries.size());
+    //накопители и буферы слов переиспользуются потоками пула, поэтому их не больше, чем потоков
+    pool.ParallelFor(raw_queries.size(), [&](size_t index) {
+        results[index] = FindTopDocuments(pool, raw_queries[index], status, max_count);
+    });
+    return results;
+}
+
+//метод создает собственный пул сервера для пакетных запросов
+void SearchServer::SetThreadCount(size_t thread_count) {
+    thread_pool_ = make_shared<const ThreadPool>(thread_count);
+}
+
+//метод возвращает пул пакетных запросов: собственный или общий пул процесса
+const ThreadPool& SearchServer::GetThreadPool() const {
+    return thread_pool_ ? *thread_pool_ : ThreadPool::GetDefault();
+}
+
+//метод выполняет пакет запросов с заданным статусом общим обходом списков постингов.
+//пространство номеров документов делится на отрезки, а запросы — на группы так, чтобы накопители
+//одной задачи занимали не больше SHARED_TERMS_SCORE_CELLS ячеек. задача обходит слова группы
+//по возрастанию id, поэтому вклады слов в релевантность документа складываются в том же порядке,
+//что и при поиске по одному запросу, и релевантности совпадают до бита
+vector<vector<Document>> SearchServer::FindTopDocumentsBatchByTerms(const vector<string_view>& raw_queries, DocumentStatus status,
+                                                                    size_t max_count) const {
+    const ThreadPool& pool = GetThreadPool();
+    vector<Query> queries(raw_queries.size());
+    pool.ParallelFor(raw_queries.size(), [&](size_t index) {
+        queries[index] = ParseQuery(raw_queries[index]);
+    });
+
+    //запросы, найденные в кэше, не обходятся
+    vector<vector<Document>> results(raw_queries.size());
+    vector<QueryCacheKey> keys(query_cache_.GetCapacity() == 0 ? 0 : queries.size());
+    vector<uint32_t> pending;
+    for (size_t index = 0; index < queries.size(); ++index) {
+        if (!keys.empty()) {
+            keys[index] = MakeQueryCacheKey(queries[index], status, max_count);
+            if (auto documents = query_cache_.Find(keys[index], index_version_)) {
+                results[index] = move(*documents);
+                continue;
+            }
+        }
+        pending.push_back(static_cast<uint32_t>(index));
+    }
+
+    const size_t document_count = ordinal_to_id_.size();
+    const size_t group_size = max<size_t>(1, min(pending.size(), SHARED_TERMS_SCORE_CELLS / SHARED_TERMS_MIN_BLOCK_SIZE));
+    const size_t group_count = (pending.size() + group_size - 1) / group_size;
+    //отрезков не меньше, чем потоков пула, если документов на это хватает
+    const size_t block_size = max(SHARED_TERMS_MIN_BLOCK_SIZE, min(SHARED_TERMS_SCORE_CELLS / group_size,
+                                                                   document_count / (pool.GetThreadCount() + 1) + 1));
+    const size_t block_count = max<size_t>(1, (document_count + block_size - 1) / block_size);
+
+    //слова каждой группы с запросами, в которые они входят, по возрастанию id слова
+    vector<vector<TermUse>> plus_uses(group_count);
+    vector<vector<TermUse>> minus_uses(group_count);
+    InverseDocumentFreqBuffer inverse_document_freqs;
+    for (size_t group = 0; group < group_count; ++group) {
+        for (size_t i = group * group_size; i < min(pending.size(), (group + 1) * group_size); ++i) {
+            const Query& query = queries[pending[i]];
+            const uint32_t local_index = static_cast<uint32_t>(i - group * group_size);
+            ComputeInverseDocumentFreqs(query, inverse_document_freqs.Get());
+            for (size_t j = 0; j < query.plus_words.size(); ++j) {
+                plus_uses[group].push_back({query.plus_words[j], local_index, inverse_document_freqs.Get()[j]});
+            }
+            for (const TermId term : query.minus_words) {
+                minus_uses[group].push_back({term, local_index, 0.0});
+            }
+        }
+        const auto by_term = [](const TermUse& lhs, const TermUse& rhs) {
+            return lhs.term < rhs.term || (lhs.term == rhs.term && lhs.query < rhs.query);
+        };
+        sort(plus_uses[group].begin(), plus_uses[group].end(), by_term);
+        sort(minus_uses[group].begin(), minus_uses[group].end(), by_term);
+    }
+
+    //задача — пара (группа, отрезок), у каждой свои топы запросов группы
+    vector<vector<TopDocuments>> task_tops(group_count * block_count);
+    pool.ParallelFor(task_tops.size(), [&](size_t task) {
+        const size_t group = task / block_count;
+        const size_t block = task % block_count;
+        const size_t query_count = min(pending.size(), (group + 1) * group_size) - group * group_size;
+        task_tops[task].assign(query_count, TopDocuments(max_count));
+        const int first_ordinal = static_cast<int>(min(document_count, block * block_size));
+        const int last_ordinal = static_cast<int>(min(document_count, (block + 1) * block_size));
+        FindSharedTermDocuments(plus_uses[group], minus_uses[group], query_count, status, first_ordinal, last_ordinal, task_tops[task]);
+    });
+
+    for (size_t i = 0; i < pending.size(); ++i) {
+        const size_t group = i / group_size;
+        TopDocuments top_documents(max_count);
+        for (size_t block = 0; block < block_count; ++block) {
+            top_documents.Merge(task_tops[group * block_count + block][i - group * group_size]);
+        }
+        results[pending[i]] = top_documents.Release();
+        if (!keys.empty()) {
+            query_cache_.Insert(move(keys[pending[i]]), index_version_, results[pending[i]]);
+        }
+    }
+    return results;
+}
+
+//метод ищет документы запросов группы на отрезке номеров, каждый список постингов отрезка читается один раз
+void SearchServer::FindSharedTermDocuments(const vector<TermUse>& plus_uses, const vector<TermUse>& minus_uses,
+                                           size_t query_count, DocumentStatus status, int first_ordinal, int last_ordinal,
+                                           vector<TopDocuments>& top_documents) const {
+    const DocumentBitmap& status_documents = status_documents_[static_cast<size_t>(status)];
+    vector<ScoreAccumulatorPool::Handle> accumulators;
+    accumulators.reserve(query_count);
+    for (size_t i = 0; i < query_count; ++i) {
+        accumulators.push_back(accumulator_pool_.Acquire(last_ordinal - first_ordinal, first_ordinal));
+    }
+    //сначала исключаются документы минус-слов: исключенный документ не получит релевантности ни от одного слова
+    for (size_t begin = 0, end = 0; begin < minus_uses.size(); begin = end) {
+        while (end < minus_uses.size() && minus_uses[end].term == minus_uses[begin].term) {
+            ++end;
+        }
+        ForEachPosting(minus_uses[begin].term, first_ordinal, last_ordinal, [&](int ordinal, double /*term_freq*/) {
+            for (size_t i = begin; i < end; ++i) {
+                accumulators[minus_uses[i].query]->Exclude(ordinal);
+            }
+        });
+    }
+    for (size_t begin = 0, end = 0; begin < plus_uses.size(); begin = end) {
+        while (end < plus_uses.size() && plus_uses[end].term == plus_uses[begin].term) {
+            ++end;
+        }
+        ForEachPosting(plus_uses[begin].term, first_ordinal, last_ordinal, [&](int ordinal, double term_freq) {
+            if (!status_documents.Test(ordinal)) {
+                return;
+            }
+            for (size_t i = begin; i < end; ++i) {
+                accumulators[plus_uses[i].query]->Add(ordinal, term_freq * plus_uses[i].inverse_document_freq);
+            }
+        });
+    }
+    for (size_t i = 0; i < query_count; ++i) {
+        SelectTopDocuments(*accumulators[i], top_documents[i]);
+    }
+}
+
+//метод возвращает ключ кэша запросов: слова разобранного запроса уже упорядочены по id,
+//поэтому одинаковые запросы дают одинаковый ключ
+QueryCacheKey SearchServer::MakeQueryCacheKey(const Query& query, DocumentStatus status, size_t max_count) {
+    QueryCacheKey key;
+    key.terms.reserve(query.plus_words.size() + query.minus_words.size());
+    key.terms.insert(key.terms.end(), query.plus_words.begin(), query.plus_words.end());
+    key.terms.insert(key.terms.end(), query.minus_words.begin(), query.minus_words.end());
+    key.plus_word_count = query.plus_words.size();
+    key.status = status;
+    key.max_count = max_count;
+    return key;
+}
+
+//пока словарь не пополнился и не перенумерован, разобранный запрос используется как есть
+bool SearchServer::IsQueryResolved(const CompiledQuery& compiled_query) const {
+    return compiled_query.dictionary_generation_ == dictionary_generation_
+           && (compiled_query.dictionary_size_ == dictionary_.GetSize()
+               || (compiled_query.unresolved_plus_words_.empty() && compiled_query.unresolved_minus_words_.empty()));
+}
+
 SearchServer::Query SearchServer::ParseQuery(const execution::sequenced_policy&, string_view text) const {
     return SearchServer::ParseQuery(text);
 }
 
-//паралельный метод парсинга
-SearchServer::Query SearchServer::ParseQuery(bool flag, string_view text) const {
-    Query query;
-    //итерируемся по отдельно сформированным словам
-    for (string_view word : SplitIntoWords(text)) {
-        //определяем слова на плюс и минус слова
-        const auto query_word = ParseQueryWord(word);
-        //если в запросе не стоп слова, то разделям минус и плюс слова
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.push_back(query_word.data);
+//метод возвращает IDF слова из кэша логарифмов, слово должно встречаться хотя бы в одном документе
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term) const {
+    return log_document_count_ - log_document_freqs_[term];
+}
+
+//метод записывает IDF плюс-слов запроса в их порядке, для слов без живых документов 0
+void SearchServer::ComputeInverseDocumentFreqs(const Query& query, vector<double>& inverse_document_freqs) const {
+    inverse_document_freqs.assign(query.plus_words.size(), 0.0);
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (GetDocumentFreq(query.plus_words[i]) != 0) {
+            inverse_document_freqs[i] = ComputeWordInverseDocumentFreq(query.plus_words[i]);
+        }
+    }
+}
+
+//метод изменяет количество документов со словом и пересчитывает log(df)
+void SearchServer::ChangeDocumentFreq(TermId term, int delta) {
+    const int document_freq = document_freqs_[term] += delta;
+    log_document_freqs_[term] = document_freq == 0 ? 0.0 : log(static_cast<double>(document_freq));
+}
+
+//метод расширяет структуры, адресуемые id слова, до term_count слов
+void SearchServer::ReserveTerms(size_t term_count) {
+    if (word_to_document_freqs_.size() < term_count) {
+        word_to_document_freqs_.resize(term_count);
+    }
+    if (document_freqs_.size() < term_count) {
+        document_freqs_.resize(term_count, 0);
+        log_document_freqs_.resize(term_count, 0.0);
+        max_term_freqs_.resize(term_count, 0.0);
+    }
+}
+
+//метод пересчитывает log(N) после изменения количества документов
+void SearchServer::UpdateDocumentCount() {
+    const int document_count = GetDocumentCount();
+    log_document_count_ = document_count == 0 ? 0.0 : log(static_cast<double>(document_count));
+    //IDF всех слов изменился, результаты запросов в кэше устарели
+    ++index_version_;
+}
+
+//метод возвращает количество живых документов со словом
+size_t SearchServer::GetDocumentFreq(TermId term) const {
+    return document_freqs_[term];
+}
+
+//метод проверяет, содержит ли документ с внутренним номером слово
+bool SearchServer::HasPosting(TermId term, int ordinal) const {
+    if (ordinal < frozen_ordinal_count_) {
+        return HasFrozenPostings(term) && frozen_index_.Contains(term, ordinal);
+    }
+    return GetTailPostings(term).count(ordinal) > 0;
+}
+
+//метод возвращает постинги слова в изменяемом хвосте, у слова без них — пустой словарь.
+//после заморозки хвост расширяется до id слова только при добавлении документа с ним
+const map<int, double>& SearchServer::GetTailPostings(TermId term) const {
+    static const map<int, double> empty_postings;
+    return term < word_to_document_freqs_.size() ? word_to_document_freqs_[term] : empty_postings;
+}
+
+//метод проверяет, есть ли у слова список постингов в замороженной части
+bool SearchServer::HasFrozenPostings(TermId term) const {
+    return term < frozen_index_.GetSlotCount();
+}
+
+//метод переводит TF слова в документе в число вхождений
+uint32_t SearchServer::GetTermCount(int ordinal, double term_freq) const {
+    return static_cast<uint32_t>(llround(term_freq / inverse_document_lengths_[ordinal]));
+}
+
+//метод дописывает статус нового документа в таблицу документов и в битовую карту статуса
+void SearchServer::AddDocumentStatus(DocumentStatus status) {
+    const int ordinal = static_cast<int>(document_statuses_.size());
+    document_statuses_.push_back(status);
+    for (DocumentBitmap &status_documents : status_documents_) {
+        status_documents.Resize(document_statuses_.size());
+    }
+    status_documents_[static_cast<size_t>(status)].Set(ordinal);
+    ++status_document_counts_[static_cast<size_t>(status)];
+}
+
+//метод возвращает внутренний номер документа, для неизвестного id бросает out_of_range
+int SearchServer::GetOrdinal(int document_id) const {
+    return document_ordinals_.at(document_id);
+}
+
+//метод удаляет документ из таблицы документов и возвращает его внутренний номер.
+//номер не переиспользуется до уплотнения, освобождаются только построенные частоты слов документа
+int SearchServer::EraseDocumentData(int document_id) {
+    const int ordinal = GetOrdinal(document_id);
+    word_freqs_.erase(ordinal);
+    const size_t status = static_cast<size_t>(document_statuses_[ordinal]);
+    status_documents_[status].Reset(ordinal);
+    --status_document_counts_[status];
+    document_ordinals_.erase(document_id);
+    document_id_.erase(document_id);
+    UpdateDocumentCount();
+    return ordinal;
+}
+
+//метод помечает документ удаленным, не изменяя списков постингов.
+//документ сразу исчезает из выдачи и из IDF, память освобождает уплотнение, которое запускает вызывающий
+void SearchServer::MarkDocumentDead(int document_id) {
+    const int ordinal = EraseDocumentData(document_id);
+    for (const TermId term : forward_index_.GetDocument(ordinal)) {
+        ChangeDocumentFreq(term, -1);
+    }
+    dead_documents_[ordinal] = true;
+    dead_ordinals_.push_back(ordinal);
+}
+
+//метод уплотняет индекс, если доля свободных номеров документов превышает max_dead_ratio_.
+//свободные номера оставляют и помеченные, и немедленно удаленные документы
+void SearchServer::CompactIfSparse() {
+    const double ordinal_count = static_cast<double>(ordinal_to_id_.size());
+    if (ordinal_count - GetDocumentCount() > max_dead_ratio_ * ordinal_count) {
+        Compact();
+    }
+}
+
+//метод нумерует живые документы подряд в порядке их номеров, номера удаленных документов -1
+vector<int> SearchServer::ComputeLiveOrdinals() const {
+    vector<int> new_ordinals(ordinal_to_id_.size(), -1);
+    int live_count = 0;
+    for (size_t ordinal = 0; ordinal < ordinal_to_id_.size(); ++ordinal) {
+        const auto it = document_ordinals_.find(ordinal_to_id_[ordinal]);
+        if (it != document_ordinals_.end() && it->second == static_cast<int>(ordinal)) {
+            new_ordinals[ordinal] = live_count++;
+        }
+    }
+    return new_ordinals;
+}
+
+//метод включает отложенное удаление
+void SearchServer::EnableTombstones(double max_dead_ratio) {
+    use_tombstones_ = true;
+    max_dead_ratio_ = max_dead_ratio;
+}
+
+//метод возвращает немедленное удаление, помеченные документы вычищаются
+void SearchServer::DisableTombstones() {
+    Compact();
+    use_tombstones_ = false;
+}
+
+//метод вычищает из индекса удаленные документы и нумерует оставшиеся подряд. порядок номеров сохраняется,
+//поэтому списки постингов остаются упорядоченными и выдача не меняется.
+//слова без живых документов удаляются из словаря, id остальных сдвигаются с сохранением порядка
+void SearchServer::Compact() {
+    const size_t live_count = static_cast<size_t>(GetDocumentCount());
+    if (live_count == ordinal_to_id_.size()) {
+        return;
+    }
+    const vector<int> new_ordinals = ComputeLiveOrdinals();
+    vector<TermId> new_terms(dictionary_.GetSize(), TermDictionary::NO_TERM);
+    TermId term_count = 0;
+    for (TermId term = 0; term < dictionary_.GetSize(); ++term) {
+        if (document_freqs_[term] > 0) {
+            new_terms[term] = term_count++;
+        }
+    }
+    if (is_frozen_) {
+        //замороженная часть и хвост сжимаются вместе с точными весами постингов,
+        //подключенные из снимка массивы освобождаются
+        FrozenIndex frozen_index;
+        vector<FrozenPosting> postings;
+        for (TermId term = 0; term < dictionary_.GetSize(); ++term) {
+            if (new_terms[term] == TermDictionary::NO_TERM) {
+                continue;
             }
-            else {
-                query.plus_words.push_back(query_word.data);
+            postings.clear();
+            max_term_freqs_[term] = 0.0;
+            ForEachPosting(term, [&](int ordinal, double term_freq) {
+                if (new_ordinals[ordinal] >= 0) {
+                    const uint32_t term_count = GetTermCount(ordinal, term_freq);
+                    postings.push_back({new_ordinals[ordinal], term_count, term_count * inverse_document_lengths_[ordinal]});
+                    max_term_freqs_[term] = max(max_term_freqs_[term], postings.back().weight);
+                }
+            });
+            frozen_index.AddPostings(postings);
+        }
+        frozen_index_ = move(frozen_index);
+        word_to_document_freqs_ = {};
+        frozen_ordinal_count_ = static_cast<int>(live_count);
+    } else {
+        for (auto& document_freqs : word_to_document_freqs_) {
+            map<int, double> compacted;
+            for (const auto& [ordinal, term_freq] : document_freqs) {
+                if (new_ordinals[ordinal] >= 0) {
+                    compacted.emplace_hint(compacted.end(), new_ordinals[ordinal], term_freq);
+                }
             }
+            document_freqs = move(compacted);
         }
     }
-    return query;
+
+    //столбцы таблицы документов сдвигаются к началу: новый номер документа не больше старого
+    const auto compact_column = [&new_ordinals, live_count](auto& column) {
+        for (size_t ordinal = 0; ordinal < new_ordinals.size(); ++ordinal) {
+            if (new_ordinals[ordinal] >= 0 && new_ordinals[ordinal] != static_cast<int>(ordinal)) {
+                column[new_ordinals[ordinal]] = move(column[ordinal]);
+            }
+        }
+        column.resize(live_count);
+        column.shrink_to_fit();
+    };
+    compact_column(ordinal_to_id_);
+    compact_column(document_ratings_);
+    compact_column(document_statuses_);
+    compact_column(document_lengths_);
+    compact_column(inverse_document_lengths_);
+    forward_index_.Compact(new_ordinals, new_terms);
+    word_freqs_.clear();
+    for (auto& [document_id, ordinal] : document_ordinals_) {
+        ordinal = new_ordinals[ordinal];
+    }
+    status_documents_ = {};
+    for (DocumentBitmap& status_documents : status_documents_) {
+        status_documents.Resize(live_count);
+    }
+    for (size_t ordinal = 0; ordinal < live_count; ++ordinal) {
+        status_documents_[static_cast<size_t>(document_statuses_[ordinal])].Set(static_cast<int>(ordinal));
+    }
+    dead_documents_.assign(live_count, false);
+    dead_ordinals_ = {};
+
+    if (term_count == dictionary_.GetSize()) {
+        return;
+    }
+    //столбцы, адресуемые id слова, сдвигаются так же, как столбцы документов
+    const auto compact_term_column = [&new_terms, term_count](auto& column) {
+        for (size_t term = 0; term < column.size(); ++term) {
+            if (new_terms[term] != TermDictionary::NO_TERM && new_terms[term] != term) {
+                column[new_terms[term]] = move(column[term]);
+            }
+        }
+        column.resize(min(column.size(), static_cast<size_t>(term_count)));
+        column.shrink_to_fit();
+    };
+    compact_term_column(word_to_document_freqs_);
+    compact_term_column(document_freqs_);
+    compact_term_column(log_document_freqs_);
+    compact_term_column(max_term_freqs_);
+    dictionary_.Compact(new_terms);
+    ++dictionary_generation_;
+    //ключи кэша запросов состоят из id слов
+    ++index_version_;
+}
+
+//метод возвращает количество помеченных, но еще не вычищенных документов
+int SearchServer::GetDeadDocumentCount() const {
+    return static_cast<int>(dead_ordinals_.size());
+}
+
+//метод замораживает индекс: хвост дописывается к спискам замороженной части блоками с целыми числами вхождений.
+//номера документов хвоста больше номеров замороженной части, поэтому списки остаются упорядоченными.
+//списки слов без постингов в хвосте копируются блоками без распаковки, пересжимаются только списки с хвостом
+void SearchServer::Freeze() {
+    if (IsFrozen()) {
+        return;
+    }
+    //слоты добавляются по порядку id слов, включая пустые списки удаленных документов.
+    //границы вкладов слов пересчитываются по тем TF, которые вернет замороженный индекс
+    FrozenIndex frozen_index;
+    vector<FrozenPosting> postings;
+    for (TermId term = 0; term < dictionary_.GetSize(); ++term) {
+        const map<int, double>& tail_postings = GetTailPostings(term);
+        if (tail_postings.empty() && HasFrozenPostings(term)) {
+            frozen_index.AddPostings(frozen_index_, term);
+            max_term_freqs_[term] = frozen_index_.GetMaxWeight(term);
+            continue;
+        }
+        postings.clear();
+        if (HasFrozenPostings(term)) {
+            frozen_index_.ForEach(term, 0, numeric_limits<int>::max(), [&](int ordinal, uint32_t term_count) {
+                postings.push_back({ordinal, term_count, term_count * inverse_document_lengths_[ordinal]});
+            });
+        }
+        for (const auto& [ordinal, term_freq] : tail_postings) {
+            const uint32_t term_count = GetTermCount(ordinal, term_freq);
+            postings.push_back({ordinal, term_count, term_count * inverse_document_lengths_[ordinal]});
+        }
+        max_term_freqs_[term] = 0.0;
+        for (const FrozenPosting& posting : postings) {
+            max_term_freqs_[term] = max(max_term_freqs_[term], posting.weight);
+        }
+        frozen_index.AddPostings(postings);
+    }
+    frozen_index_ = move(frozen_index);
+    word_to_document_freqs_ = {};
+    frozen_ordinal_count_ = static_cast<int>(ordinal_to_id_.size());
+    is_frozen_ = true;
+    //TF теперь считается из числа вхождений и может отличаться в последних знаках
+    ++index_version_;
+}
+
+//метод сообщает, заморожен ли индекс целиком: после заморозки не добавлено ни одного документа
+bool SearchServer::IsFrozen() const {
+    return is_frozen_ && frozen_ordinal_count_ == static_cast<int>(ordinal_to_id_.size());
+}
+
+//курсор начинает с замороженной части, если у слова есть в ней постинги от first_ordinal,
+//и переходит в хвост, когда они кончаются
+SearchServer::PostingCursor::PostingCursor(const SearchServer& search_server, TermId term, int first_ordinal)
+        : search_server_(&search_server), term_(term) {
+    if (first_ordinal < search_server.frozen_ordinal_count_ && search_server.HasFrozenPostings(term)) {
+        frozen_cursor_.emplace(search_server.frozen_index_, term);
+        frozen_cursor_->Seek(first_ordinal);
+        if (frozen_cursor_->IsEnd()) {
+            frozen_cursor_.reset();
+        }
+    }
+    document_freqs_ = &search_server.GetTailPostings(term);
+    it_ = document_freqs_->lower_bound(first_ordinal);
+    SkipDead();
+}
+
+bool SearchServer::PostingCursor::IsEnd() const {
+    return !frozen_cursor_ && it_ == document_freqs_->end();
+}
+
+int SearchServer::PostingCursor::GetOrdinal() const {
+    return frozen_cursor_ ? frozen_cursor_->GetOrdinal() : it_->first;
+}
+
+double SearchServer::PostingCursor::GetTermFreq() const {
+    if (frozen_cursor_) {
+        return frozen_cursor_->GetCount() * search_server_->inverse_document_lengths_[frozen_cursor_->GetOrdinal()];
+    }
+    return it_->second;
+}
+
+//метод переходит к следующему постингу
+void SearchServer::PostingCursor::Next() {
+    Advance();
+    SkipDead();
+}
+
+//метод переходит к первому постингу с номером документа не меньше ordinal
+void SearchServer::PostingCursor::Seek(int ordinal) {
+    if (IsEnd() || GetOrdinal() >= ordinal) {
+        return;
+    }
+    if (frozen_cursor_) {
+        frozen_cursor_->Seek(ordinal);
+        if (!frozen_cursor_->IsEnd()) {
+            SkipDead();
+            return;
+        }
+        frozen_cursor_.reset();
+    }
+    it_ = document_freqs_->lower_bound(ordinal);
+    SkipDead();
+}
+
+//метод возвращает границу вклада слова для документов от ordinal до конца блока, в котором он лежал бы.
+//у хвоста блоков нет, и граница одна на весь хвост
+FrozenIndex::BlockBound SearchServer::PostingCursor::PeekBlock(int ordinal) const {
+    const int frozen_ordinal_count = search_server_->frozen_ordinal_count_;
+    if (ordinal < frozen_ordinal_count) {
+        //за последним блоком слова в замороженной части граница нулевая до начала хвоста
+        FrozenIndex::BlockBound block = frozen_cursor_ ? frozen_cursor_->PeekBlock(ordinal) : FrozenIndex::BlockBound{};
+        block.last_ordinal = min(frozen_cursor_ ? block.last_ordinal : numeric_limits<int>::max(), frozen_ordinal_count - 1);
+        return block;
+    }
+    if (IsEnd()) {
+        return {0.0, numeric_limits<int>::max()};
+    }
+    return {search_server_->max_term_freqs_[term_], numeric_limits<int>::max()};
+}
+
+//метод переходит к следующему постингу, после последнего постинга замороженной части — в хвост
+void SearchServer::PostingCursor::Advance() {
+    if (!frozen_cursor_) {
+        ++it_;
+        return;
+    }
+    frozen_cursor_->Next();
+    if (frozen_cursor_->IsEnd()) {
+        frozen_cursor_.reset();
+    }
+}
+
+//метод пропускает помеченные удаленными документы
+void SearchServer::PostingCursor::SkipDead() {
+    if (search_server_->dead_ordinals_.empty()) {
+        return;
+    }
+    while (!IsEnd() && search_server_->dead_documents_[GetOrdinal()]) {
+        Advance();
+    }
+}
+
+//метод создает курсоры по словам, начиная с документа first_ordinal
+vector<SearchServer::PostingCursor> SearchServer::MakePostingCursors(const QueryTerms& terms, int first_ordinal) const {
+    vector<PostingCursor> cursors;
+    cursors.reserve(terms.size());
+    for (const TermId term : terms) {
+        cursors.emplace_back(*this, term, first_ordinal);
+    }
+    return cursors;
+}
+
+//метод проверяет переходом курсоров, содержит ли документ хотя бы одно из их слов.
+//документы должны проверяться по возрастанию номеров
+bool SearchServer::ContainsAny(vector<PostingCursor>& cursors, int ordinal) {
+    return any_of(cursors.begin(), cursors.end(), [ordinal](PostingCursor& cursor) {
+        cursor.Seek(ordinal);
+        return !cursor.IsEnd() && cursor.GetOrdinal() == ordinal;
+    });
+}
+
+//метод проверяет, стоит ли искать с отсечением: слов должно быть несколько, а отбор меньше отрезка
+bool SearchServer::IsPruningUseful(const Query& query, size_t max_count, size_t document_count) {
+    return query.plus_words.size() > 1 && max_count < document_count;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const string &word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+//метод отбирает лучшие документы накопителя
+void SearchServer::SelectTopDocuments(const ScoreAccumulator& accumulator, TopDocuments& top_documents) const {
+    accumulator.ForEach([&](int ordinal, double relevance) {
+        top_documents.Add({ordinal_to_id_[ordinal], relevance, document_ratings_[ordinal]});
+    });
 }
 
-//метод получения частот слов по id документа
+//метод определяет, на сколько отрезков номеров документов делить параллельный запрос:
+//не больше числа потоков и не меньше MIN_POSTINGS_PER_SLICE постингов на отрезок
+size_t SearchServer::GetSliceCount(const Query& query, size_t thread_count) const {
+    size_t posting_count = 0;
+    for (const TermId term : query.plus_words) {
+        posting_count += GetDocumentFreq(term);
+    }
+    for (const TermId term : query.minus_words) {
+        posting_count += GetDocumentFreq(term);
+    }
+    return clamp<size_t>(posting_count / MIN_POSTINGS_PER_SLICE, 1, max<size_t>(1, thread_count));
+}
+
+//метод получения частот слов по id документа. частоты строятся по прямому индексу при первом вызове
+//для документа и живут, пока документ не удален
 const map<string_view, double> &SearchServer::GetWordFrequencies(int document_id) const {
     static map<string_view, double> word_freqs;
-    if (word_freqs_.count(document_id) == 0) {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
         return word_freqs;
     }
-    return word_freqs_.at(document_id);
+    lock_guard guard(*word_freqs_mutex_);
+    const auto [document_word_freqs, is_new] = word_freqs_.try_emplace(it->second);
+    if (is_new) {
+        const ForwardIndex::DocumentTerms document = forward_index_.GetDocument(it->second);
+        for (size_t i = 0; i < document.size; ++i) {
+            document_word_freqs->second.emplace(dictionary_.GetWord(document.terms[i]), document.term_freqs[i]);
+        }
+    }
+    return document_word_freqs->second;
 }
 
 //метод удаления документов из поискового сервера
+//удаление идет по прямому индексу документа и стоит O(длины документа), а не O(словаря)
 void SearchServer::RemoveDocument(int document_id) {
-    documents_.erase(document_id);
-    document_id_.erase(document_id);
-    word_freqs_.erase(document_id);
-    for (auto& [key, value] : word_to_document_freqs_) {
-        value.erase(document_id);
+    if (document_ordinals_.count(document_id) == 0) {
+        return;
     }
+    RemoveDocument(execution::seq, document_id);
 }
 
-//однопоточный метод удаления документов из поискового сервера
+//однопоточный метод удаления документов из поискового сервера.
+//документ замороженной части только помечается: сжатые списки не переписываются ради одного документа
 void SearchServer::RemoveDocument(const execution::sequenced_policy&, int document_id) {
-    vector<string> marks(word_freqs_.at(document_id).size());
-    transform(execution::seq, word_freqs_.at(document_id).begin(), word_freqs_.at(document_id).end(), marks.begin(), [](auto& it) {
-        return it.first;
-    });
+    if (use_tombstones_ || GetOrdinal(document_id) < frozen_ordinal_count_) {
+        MarkDocumentDead(document_id);
+        CompactIfSparse();
+        return;
+    }
+    const int ordinal = EraseDocumentData(document_id);
+    const ForwardIndex::DocumentTerms terms = forward_index_.GetDocument(ordinal);
 
-    auto p = [this, document_id](auto it) {
-        word_to_document_freqs_.at(it).erase(document_id);
+    auto p = [this, ordinal](TermId term) {
+        word_to_document_freqs_[term].erase(ordinal);
+        ChangeDocumentFreq(term, -1);
     };
 
-    document_id_.erase(document_id);
-    documents_.erase(document_id);
-    word_freqs_.erase(document_id);
-    for_each(std::execution::seq, marks.begin(), marks.end(), p);
+    for_each(std::execution::seq, terms.begin(), terms.end(), p);
+    CompactIfSparse();
 }
 
 //паралельный метод удаления документов из поискового сервера
 void SearchServer::RemoveDocument(const execution::parallel_policy&, int document_id) {
-    vector<string*> marks(word_freqs_.at(document_id).size(), nullptr);
-    transform(execution::par, word_freqs_.at(document_id).begin(), word_freqs_.at(document_id).end(), marks.begin(), [](auto& it) {
-        return new string(it.first);
-    });
+    if (use_tombstones_ || GetOrdinal(document_id) < frozen_ordinal_count_) {
+        MarkDocumentDead(document_id);
+        CompactIfSparse();
+        return;
+    }
+    const int ordinal = EraseDocumentData(document_id);
+    const ForwardIndex::DocumentTerms terms = forward_index_.GetDocument(ordinal);
 
-    auto p = [this, document_id](auto it) {
-        word_to_document_freqs_.at(*it).erase(document_id);
+    //id слов документа различны, поэтому потоки изменяют разные списки постингов и ячейки кэша IDF
+    auto p = [this, ordinal](TermId term) {
+        word_to_document_freqs_[term].erase(ordinal);
+        ChangeDocumentFreq(term, -1);
     };
 
-    document_id_.erase(document_id);
-    documents_.erase(document_id);
-    word_freqs_.erase(document_id);
-    for_each(std::execution::par, marks.begin(), marks.end(), p);
-}
\ No newline at end of file
+    for_each(std::execution::par, terms.begin(), terms.end(), p);
+    CompactIfSparse();
+}
+
+//метод удаляет пакет документов, неизвестные id пропускаются
+void SearchServer::RemoveDocuments(const vector<int>& document_ids) {
+    RemoveDocumentBatch(execution::seq, document_ids);
+}
+
+//однопоточный метод удаляет пакет документов
+void SearchServer::RemoveDocuments(const execution::sequenced_policy& policy, const vector<int>& document_ids) {
+    RemoveDocumentBatch(policy, document_ids);
+}
+
+//паралельный метод удаляет пакет документов, группы слов обрабатываются разными потоками
+void SearchServer::RemoveDocuments(const execution::parallel_policy& policy, const vector<int>& document_ids) {
+    RemoveDocumentBatch(policy, document_ids);
+}
+
+//метод пакетного добавления документов
+void SearchServer::AddDocuments(const vector<NewDocument>& documents) {
+    AddDocumentBatch(execution::seq, documents);
+}
+
+//однопоточный метод пакетного добавления документов
+void SearchServer::AddDocuments(const execution::sequenced_policy& policy, const vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents);
+}
+
+//паралельный метод пакетного добавления документов
+void SearchServer::AddDocuments(const execution::parallel_policy& policy, const vector<NewDocument>& documents) {
+    AddDocumentBatch(policy, documents);
+}
+
+//метод переносит живые документы другого сервера, слова и TF берутся из его прямого индекса
+void SearchServer::AddDocuments(const SearchServer& other) {
+    for (const auto& [document_id, ordinal] : other.document_ordinals_) {
+        if (document_ordinals_.count(document_id) > 0) {
+            throw std::invalid_argument("Invalid document_id");
+        }
+    }
+    //документы переносятся в порядке их внутренних номеров, поэтому хвосты списков постингов растут с конца
+    for (size_t other_ordinal = 0; other_ordinal < other.ordinal_to_id_.size(); ++other_ordinal) {
+        const int document_id = other.ordinal_to_id_[other_ordinal];
+        const auto it = other.document_ordinals_.find(document_id);
+        if (it == other.document_ordinals_.end() || it->second != static_cast<int>(other_ordinal)) {
+            continue;
+        }
+        const int ordinal = static_cast<int>(ordinal_to_id_.size());
+        const ForwardIndex::DocumentTerms other_document = other.forward_index_.GetDocument(static_cast<int>(other_ordinal));
+        vector<pair<TermId, double>> term_freqs;
+        for (size_t i = 0; i < other_document.size; ++i) {
+            term_freqs.emplace_back(dictionary_.Intern(other.dictionary_.GetWord(other_document.terms[i])), other_document.term_freqs[i]);
+        }
+        //id слов в словарях серверов различаются, прямой индекс упорядочивается по своим id
+        sort(term_freqs.begin(), term_freqs.end());
+        if (!term_freqs.empty()) {
+            ReserveTerms(term_freqs.back().first + 1);
+        }
+        for (const auto& [term, term_freq] : term_freqs) {
+            word_to_document_freqs_[term].emplace_hint(word_to_document_freqs_[term].end(), ordinal, term_freq);
+            ChangeDocumentFreq(term, 1);
+            max_term_freqs_[term] = max(max_term_freqs_[term], term_freq);
+        }
+        forward_index_.AddDocument(term_freqs);
+        ordinal_to_id_.push_back(document_id);
+        dead_documents_.push_back(false);
+        document_ratings_.push_back(other.document_ratings_[other_ordinal]);
+        AddDocumentStatus(other.document_statuses_[other_ordinal]);
+        document_lengths_.push_back(other.document_lengths_[other_ordinal]);
+        inverse_document_lengths_.push_back(other.inverse_document_lengths_[other_ordinal]);
+        document_ordinals_.emplace(document_id, ordinal);
+        document_id_.insert(document_id);
+    }
+    UpdateDocumentCount();
+}
+
+//метод сохраняет индекс в двоичный снимок
+void SearchServer::Save(const string& path) const {
+    //живые документы перенумеровываются подряд, порядок номеров сохраняется
+    const vector<int> new_ordinals = ComputeLiveOrdinals();
+    vector<int32_t> ids;
+    vector<int32_t> ratings;
+    vector<uint8_t> statuses;
+    vector<uint32_t> lengths;
+    for (size_t ordinal = 0; ordinal < ordinal_to_id_.size(); ++ordinal) {
+        if (new_ordinals[ordinal] >= 0) {
+            ids.push_back(ordinal_to_id_[ordinal]);
+            ratings.push_back(document_ratings_[ordinal]);
+            statuses.push_back(static_cast<uint8_t>(document_statuses_[ordinal]));
+            lengths.push_back(document_lengths_[ordinal]);
+        }
+    }
+
+    //списки постингов пишутся сжатыми блоками замороженного индекса
+    FrozenIndex frozen_index;
+    vector<FrozenPosting> postings;
+    for (TermId term = 0; term < dictionary_.GetSize(); ++term) {
+        postings.clear();
+        ForEachPosting(term, [&](int ordinal, double term_freq) {
+            if (new_ordinals[ordinal] >= 0) {
+                const uint32_t term_count = GetTermCount(ordinal, term_freq);
+                postings.push_back({new_ordinals[ordinal], term_count, term_count * inverse_document_lengths_[ordinal]});
+            }
+        });
+        frozen_index.AddPostings(postings);
+    }
+
+    SnapshotWriter writer(path);
+    writer.WriteHeader();
+    writer.Write(static_cast<uint64_t>(stop_words_.size()));
+    for (const string& word : stop_words_) {
+        writer.WriteString(word);
+    }
+    writer.Write(static_cast<uint64_t>(dictionary_.GetSize()));
+    for (TermId term = 0; term < dictionary_.GetSize(); ++term) {
+        writer.WriteString(dictionary_.GetWord(term));
+    }
+    writer.Write(static_cast<uint64_t>(ids.size()));
+    writer.WriteArray(ids);
+    writer.WriteArray(ratings);
+    writer.WriteArray(statuses);
+    writer.WriteArray(lengths);
+    //прямой индекс: id слов документа по возрастанию и их TF
+    forward_index_.Save(writer, new_ordinals);
+    frozen_index.Save(writer);
+    writer.Finish();
+}
+
+//метод загружает снимок, списки постингов остаются в отображенном в память файле
+SearchServer SearchServer::Load(const string& path) {
+    const auto file = make_shared<MappedFile>(path);
+    SnapshotReader reader(file->GetData(), file->GetSize());
+    reader.ReadHeader();
+
+    vector<string> stop_words(reader.Read<uint64_t>());
+    for (string& word : stop_words) {
+        word = string(reader.ReadString());
+    }
+    SearchServer server(stop_words);
+
+    const uint64_t term_count = reader.Read<uint64_t>();
+    for (uint64_t term = 0; term < term_count; ++term) {
+        if (server.dictionary_.Intern(reader.ReadString()) != term) {
+            throw runtime_error("Snapshot dictionary has duplicate words");
+        }
+    }
+
+    const uint64_t document_count = reader.Read<uint64_t>();
+    const int32_t* ids = reader.ReadArray<int32_t>(document_count);
+    const int32_t* ratings = reader.ReadArray<int32_t>(document_count);
+    const uint8_t* statuses = reader.ReadArray<uint8_t>(document_count);
+    const uint32_t* lengths = reader.ReadArray<uint32_t>(document_count);
+    server.ordinal_to_id_.assign(ids, ids + document_count);
+    server.document_ratings_.assign(ratings, ratings + document_count);
+    server.document_statuses_.reserve(document_count);
+    server.dead_documents_.assign(document_count, false);
+    for (uint64_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        if (statuses[ordinal] > static_cast<uint8_t>(DocumentStatus::REMOVED) || ids[ordinal] < 0
+            || !server.document_ordinals_.emplace(ids[ordinal], static_cast<int>(ordinal)).second) {
+            throw runtime_error("Snapshot document table is corrupted");
+        }
+        server.AddDocumentStatus(static_cast<DocumentStatus>(statuses[ordinal]));
+        server.document_lengths_.push_back(lengths[ordinal]);
+        server.inverse_document_lengths_.push_back(ComputeInverseLength(lengths[ordinal]));
+        server.document_id_.insert(ids[ordinal]);
+    }
+
+    //прямой индекс тоже не копируется и не разбирается в словари частот: частоты слов документа
+    //строятся при первом вызове GetWordFrequencies
+    server.forward_index_.Attach(reader, document_count, term_count, file);
+    for (uint64_t ordinal = 0; ordinal < document_count; ++ordinal) {
+        //у документа только из стоп-слов нет ни одного слова в прямом индексе
+        if (lengths[ordinal] == 0 && server.forward_index_.GetDocument(static_cast<int>(ordinal)).size != 0) {
+            throw runtime_error("Snapshot forward index is corrupted");
+        }
+    }
+
+    //списки постингов не копируются: замороженный индекс читает сжатые блоки из отображения файла
+    server.frozen_index_.Attach(reader, static_cast<int>(document_count), file);
+    if (server.frozen_index_.GetSlotCount() != term_count) {
+        throw runtime_error("Snapshot postings are corrupted");
+    }
+    server.document_freqs_.resize(term_count, 0);
+    server.log_document_freqs_.resize(term_count, 0.0);
+    server.max_term_freqs_.resize(term_count, 0.0);
+    for (TermId term = 0; term < term_count; ++term) {
+        server.ChangeDocumentFreq(term, static_cast<int>(server.frozen_index_.GetPostingCount(term)));
+        server.max_term_freqs_[term] = server.frozen_index_.GetMaxWeight(term);
+    }
+    server.frozen_ordinal_count_ = static_cast<int>(document_count);
+    server.is_frozen_ = true;
+    server.UpdateDocumentCount();
+    return server;
+}
+
+//метод включает кэш результатов запросов с фильтром по статусу
+void SearchServer::EnableQueryCache(size_t capacity) {
+    query_cache_.SetCapacity(capacity);
+}
+
+//метод выключает кэш запросов
+void SearchServer::DisableQueryCache() {
+    query_cache_.SetCapacity(0);
+}
+
+//метод возвращает счетчики попаданий и промахов кэша запросов
+QueryCacheStats SearchServer::GetQueryCacheStats() const {
+    return query_cache_.GetStats();
+}
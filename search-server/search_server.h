@@ -2,57 +2,229 @@
 
 #include <map>
 #include <set>
+#include <array>
 #include <deque>
 #include <cmath>
 #include <mutex>
+#include <tuple>
 #include <future>
 #include <atomic>
 #include <string>
 #include <vector>
+#include <limits>
+#include <memory>
 #include <utility>
+#include <optional>
+#include <numeric>
 #include <iostream>
 #include <algorithm>
+#include <exception>
 #include <stdexcept>
 #include <execution>
 #include <functional>
 #include <string_view>
+#include <unordered_map>
 
 #include "document.h"
 #include "log_duration.h"
+#include "snapshot_io.h"
+#include "frozen_index.h"
+#include "forward_index.h"
+#include "small_vector.h"
+#include "document_bitmap.h"
+#include "top_documents.h"
+#include "thread_pool.h"
+#include "stop_word_filter.h"
+#include "query_result_cache.h"
+#include "score_accumulator.h"
+#include "term_dictionary.h"
 #include "concurrent_map.h"
 #include "string_processing.h"
 #include "read_input_functions.h"
 
-constexpr double PRECISION = 1e-6;
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const unsigned int CPU_THREAD = std::thread::hardware_concurrency();
+//минимальное количество постингов запроса на один поток параллельного поиска
+const size_t MIN_POSTINGS_PER_SLICE = 4096;
+//доля свободных номеров документов, после которой удаление запускает уплотнение. при пороге 0.5
+//уплотнение стоит амортизированно O(1) постингов на каждый постинг удаленных документов, а память индекса
+//не больше чем вдвое превышает память живых документов
+const double DEFAULT_MAX_DEAD_RATIO = 0.5;
+//запас порога отсечения документов на ошибки округления при суммировании вкладов слов
+const double PRUNING_MARGIN = 1e-9;
+//количество плюс- или минус-слов запроса, которое хранится без выделения памяти
+const size_t QUERY_INLINE_TERM_COUNT = 16;
+//количество запросов, результаты которых по умолчанию хранит кэш запросов
+const size_t DEFAULT_QUERY_CACHE_CAPACITY = 4096;
+//количество ячеек накопителей (запросов × документов отрезка), которое одна задача пакетного поиска
+//с общими словами держит одновременно
+const size_t SHARED_TERMS_SCORE_CELLS = size_t{1} << 20;
+//наименьший отрезок номеров документов задачи пакетного поиска с общими словами
+const size_t SHARED_TERMS_MIN_BLOCK_SIZE = 4096;
+
+//документ для пакетного добавления методом AddDocuments
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+//фильтр документов только по статусу. поиск распознает его и проверяет статус по битовой карте
+//документов этого статуса, не вызывая фильтр для каждого постинга, а документы с другим статусом
+//пропускает отрезками. методы поиска с заданным статусом пользуются им сами
+struct DocumentStatusFilter {
+    DocumentStatus status = DocumentStatus::ACTUAL;
+
+    bool operator()(int /*document_id*/, DocumentStatus document_status, int /*rating*/) const {
+        return document_status == status;
+    }
+};
+
+//фильтр, исключающий документы, отмеченные в битовой карте внутренних номеров сервера (ее заполняет
+//SearchServer::MarkDocuments), остальные документы проверяются фильтром document_predicate.
+//исключенные документы поиск пропускает по битовой карте, а фильтр по статусу остается на своей карте
+template <typename DocumentPredicate>
+struct ExcludingDocumentsFilter {
+    DocumentPredicate document_predicate;
+    const DocumentBitmap* excluded_documents = nullptr;
+};
+
+template <typename DocumentPredicate>
+struct IsExcludingDocumentsFilter : std::false_type {};
+
+template <typename DocumentPredicate>
+struct IsExcludingDocumentsFilter<ExcludingDocumentsFilter<DocumentPredicate>> : std::true_type {};
+
+//порядок, в котором пакетный поиск отдает результаты запросов
+enum class QueryResultOrder {
+    //по порядку запросов в пакете: результат запроса ждет завершения всех предыдущих
+    QUERY_ORDER,
+    //по мере завершения запросов
+    COMPLETION_ORDER,
+};
 
 class SearchServer {
+    //слова запроса хранятся как id словаря, слов вне словаря в запросе нет.
+    //короткий запрос помещается в SmallVector без выделения памяти
+    using QueryTerms = SmallVector<TermId, QUERY_INLINE_TERM_COUNT>;
+    struct Query {
+        QueryTerms plus_words;
+        QueryTerms minus_words;
+    };
+
 public:
+    //скомпилированный запрос: слова разобраны и переведены в id словаря один раз, и запрос
+    //выполняется многократно без повторного разбора. слова, которых еще не было в словаре,
+    //запоминаются и находятся заново, если после компиляции словарь пополнился.
+    //запрос привязан к серверу, который его скомпилировал
+    class CompiledQuery {
+    private:
+        friend class SearchServer;
+
+        CompiledQuery() = default;
+
+        Query query_;
+        //слова вне словаря на момент компиляции и размер словаря тогда же
+        std::vector<std::string> unresolved_plus_words_;
+        std::vector<std::string> unresolved_minus_words_;
+        size_t dictionary_size_ = 0;
+        //текст запроса и поколение словаря: после уплотнения, перенумеровавшего слова, запрос разбирается заново
+        std::string raw_query_;
+        uint64_t dictionary_generation_ = 0;
+    };
+
     template <typename StringContainer>
     explicit SearchServer(const StringContainer &stop_words);
+    //конструктор со стоп-словами, известными при сборке: constexpr auto stop_words = MakeStopWordFilter("and", "in");
+    //таблица стоп-слов копируется из построенной компилятором
+    template <size_t N>
+    explicit SearchServer(const StaticStopWordFilter<N> &stop_words);
     explicit SearchServer( std::string_view stop_words_text);
     explicit SearchServer( const std::string &stop_words_text);
+    //копия сервера независима от исходного: слова частот документов указывают в собственный словарь копии
+    SearchServer(const SearchServer &other);
+    SearchServer(SearchServer &&other) = default;
 
     //метод добавления документов
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+    //метод проверяет, что документ можно добавить, не изменяя индекс: при неверном id или слове
+    //бросает invalid_argument так же, как AddDocument
+    void CheckNewDocument(int document_id, std::string_view document) const;
+    //метод пакетного добавления документов. при ошибке в любом документе пакета
+    //исключение бросается до изменения индекса
+    void AddDocuments(const std::vector<NewDocument>& documents);
+    //однопоточный метод пакетного добавления документов
+    void AddDocuments(const std::execution::sequenced_policy&, const std::vector<NewDocument>& documents);
+    //паралельный метод пакетного добавления документов: разбиение на слова, расчет TF
+    //и слияние постингов по словам идут параллельно
+    void AddDocuments(const std::execution::parallel_policy&, const std::vector<NewDocument>& documents);
+    //метод переносит живые документы другого сервера с теми же стоп-словами: слова и TF берутся
+    //из его прямого индекса, тексты не нужны. при совпадении id исключение бросается до изменения индекса
+    void AddDocuments(const SearchServer& other);
 
-    //метод поиска топ докуметов с лямбдой
+    //метод поиска топ докуметов с лямбдой, max_count задает размер топа
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     //метод поиска топ докуметов с заданным статусом
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     //метод поиска топ докуметов с актуальным статусом
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
     //однопоточный/паралельный метод поиска топ докуметов с лямбдой
     template <typename DocumentPredicate, typename Policy>
-    std::vector<Document> FindTopDocuments(const Policy&, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const Policy&, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     //однопоточный/паралельный метод поиска топ докуметов с заданным статусом
     template <typename Policy>
-    std::vector<Document> FindTopDocuments(const Policy&, std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const Policy&, std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     //однопоточный/паралельный метод поиска топ докуметов с актуальным статусом
     template <typename Policy>
     std::vector<Document> FindTopDocuments(const Policy&, std::string_view raw_query) const;
+    //метод поиска по одному сегменту составного индекса: IDF слова берется из inverse_document_freq(word),
+    //то есть из статистики всего индекса, а не только этого сервера
+    template <typename DocumentPredicate, typename Policy, typename InverseDocumentFreq>
+    std::vector<Document> FindTopDocuments(const Policy&, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count, InverseDocumentFreq inverse_document_freq) const;
+    //метод выполняет пакет запросов с заданным статусом на пуле потоков сервера. запросы раздаются потокам
+    //по одному с перехватом работы, тяжелые запросы дополнительно делятся на отрезки номеров документов
+    //на том же пуле. тексты запросов не копируются
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries,
+                                                             DocumentStatus status = DocumentStatus::ACTUAL,
+                                                             size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //метод выполняет пакет запросов с заданным статусом на пуле потоков сервера и передает результат каждого
+    //запроса в callback(index, std::vector<Document>&&) сразу по готовности, не дожидаясь всего пакета.
+    //вызовы callback не пересекаются по времени, но идут из потоков пула. запросы вычисляются без блокировки,
+    //при QUERY_ORDER под мьютексом только складывается готовый результат, а callback вызывается вне его
+    template <typename Callback>
+    void FindTopDocumentsBatchStreamed(const std::vector<std::string_view>& raw_queries, Callback callback,
+                                       QueryResultOrder order = QueryResultOrder::QUERY_ORDER,
+                                       DocumentStatus status = DocumentStatus::ACTUAL,
+                                       size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //метод выполняет пакет запросов с заданным статусом общим обходом списков постингов: запросы пакета
+    //группируются по словам, и постинги каждого слова читаются один раз для всех запросов группы.
+    //выгоден для больших пакетов похожих запросов, результат совпадает с FindTopDocumentsBatch
+    std::vector<std::vector<Document>> FindTopDocumentsBatchByTerms(const std::vector<std::string_view>& raw_queries,
+                                                                    DocumentStatus status = DocumentStatus::ACTUAL,
+                                                                    size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //метод создает собственный пул сервера на thread_count потоков для пакетных запросов.
+    //до вызова пакеты выполняются на общем пуле процесса, копии сервера пользуются тем же пулом
+    void SetThreadCount(size_t thread_count);
+    //метод компилирует запрос для многократного выполнения
+    CompiledQuery CompileQuery(std::string_view raw_query) const;
+    //метод поиска топ докуметов по скомпилированному запросу с заданным статусом
+    std::vector<Document> FindTopDocuments(const CompiledQuery& query, DocumentStatus status = DocumentStatus::ACTUAL,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //однопоточный/паралельный метод поиска топ докуметов по скомпилированному запросу с лямбдой
+    template <typename DocumentPredicate, typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy&, const CompiledQuery& query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //однопоточный/паралельный метод поиска топ докуметов по скомпилированному запросу с заданным статусом
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy&, const CompiledQuery& query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     //метод возвращает все плюс-слова запроса, содержащиеся в документе отсортированые по возрастанию.
     //если нет пересечений по плюс-словам или есть минус-слово, вектор слов возвращается пустым.
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
@@ -63,6 +235,16 @@ public:
 
     //метод возвращает количество документов в поисковой системе.
     int GetDocumentCount() const ;
+    //метод проверяет, есть ли документ в поисковой системе
+    bool HasDocument(int document_id) const;
+    //метод возвращает количество документов, содержащих слово
+    int GetDocumentFrequency(std::string_view word) const;
+    //метод разбирает запрос так же, как поиск, и возвращает его различные плюс-слова без стоп-слов по возрастанию,
+    //включая слова вне словаря. представления указывают в raw_query, некорректный запрос вызывает invalid_argument
+    std::vector<std::string_view> ParseQueryPlusWords(std::string_view raw_query) const;
+    //метод отмечает в битовой карте внутренние номера документов с id из document_ids, неизвестные id пропускаются.
+    //карта расширяется до количества номеров сервера и годится для ExcludingDocumentsFilter, пока сервер не изменяется
+    void MarkDocuments(const std::vector<int>& document_ids, DocumentBitmap& documents) const;
 
     //метод возвращает приватную переменную id документов
     //изменил все методв на set для хранения document_id
@@ -79,26 +261,210 @@ public:
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     //паралельный метод удаляет документ
     void RemoveDocument(const std::execution::parallel_policy& policy, int document_id);
+    //метод удаляет пакет документов, неизвестные id пропускаются.
+    //постинги удаляются группами по словам, каждый список постингов обходится один раз
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    //однопоточный метод удаляет пакет документов
+    void RemoveDocuments(const std::execution::sequenced_policy&, const std::vector<int>& document_ids);
+    //паралельный метод удаляет пакет документов, группы слов обрабатываются разными потоками
+    void RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids);
 
-    //метод получения частот слов по id документа
+    //метод получения частот слов по id документа, частоты строятся по прямому индексу при первом обращении
     const std::map<std::string_view, double> &GetWordFrequencies(int document_id) const;
 
+    //метод замораживает индекс: списки постингов переносятся в плоские массивы,
+    //и запросы читают их последовательно. документы, добавленные после заморозки, попадают в изменяемый хвост,
+    //а удаленные из замороженной части помечаются до уплотнения: изменение стоит O(длины документа),
+    //и следующий Freeze дописывает хвост к замороженным спискам
+    void Freeze();
+    //метод сообщает, заморожен ли индекс целиком: заморозка была и хвост после нее пуст
+    bool IsFrozen() const;
+
+    //метод включает отложенное удаление: RemoveDocument и RemoveDocuments только помечают документ,
+    //а его постинги и данные вычищает уплотнение. уплотнение запускается само, когда доля
+    //помеченных документов превышает max_dead_ratio (при 1.0 — только явным вызовом Compact)
+    void EnableTombstones(double max_dead_ratio = DEFAULT_MAX_DEAD_RATIO);
+    //метод возвращает немедленное удаление, помеченные документы вычищаются
+    void DisableTombstones();
+    //метод вычищает из индекса документы, помеченные удаленными, и нумерует оставшиеся документы подряд:
+    //списки постингов и таблица документов переписываются под новые номера, порядок номеров сохраняется.
+    //замороженный индекс уплотняется на месте и остается замороженным. слова, которых не осталось ни в одном
+    //документе, удаляются из словаря, остальные получают id подряд; представления слов, полученные
+    //из GetWordFrequencies и MatchDocument до уплотнения, становятся недействительными.
+    //после немедленного удаления RemoveDocument и RemoveDocuments уплотнение тоже запускается само, когда доля
+    //свободных номеров превышает max_dead_ratio
+    void Compact();
+    //метод возвращает количество помеченных, но еще не вычищенных документов
+    int GetDeadDocumentCount() const;
+
+    //метод сохраняет индекс в двоичный снимок: стоп-слова, словарь, таблицу документов,
+    //прямой индекс и списки постингов. удаленные документы в снимок не попадают. снимок пишется во временный
+    //файл и подменяет path переименованием, поэтому сохранять можно и поверх снимка, загруженного этим сервером
+    void Save(const std::string& path) const;
+    //метод загружает снимок. списки постингов и прямой индекс читаются прямо из отображенного в память файла,
+    //загруженный индекс заморожен; при ошибке чтения бросается runtime_error
+    static SearchServer Load(const std::string& path);
+
+    //метод включает кэш результатов запросов с фильтром по статусу на capacity запросов.
+    //кэш общий для всех потоков, записи устаревают при любом изменении документов.
+    //запросы с лямбдой не кэшируются
+    void EnableQueryCache(size_t capacity = DEFAULT_QUERY_CACHE_CAPACITY);
+    //метод выключает кэш запросов и освобождает его память
+    void DisableQueryCache();
+    //метод возвращает количество попаданий и промахов кэша запросов с момента его включения
+    QueryCacheStats GetQueryCacheStats() const;
+
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
     //id документов, изменил на set для хранения document_id
     std::set<int> document_id_;
-    std::deque<std::string> deque_document_structure_ ;
-    //структура документов
-    std::map<int, DocumentData> documents_;
+    //внешний id документа → внутренний плотный номер, номера выдаются по возрастанию
+    std::map<int, int> document_ordinals_;
+    //таблица документов по столбцам, индекс — внутренний номер документа
+    std::vector<int> ordinal_to_id_;
+    std::vector<int> document_ratings_;
+    std::vector<DocumentStatus> document_statuses_;
+    //живые документы каждого статуса и их количество
+    std::array<DocumentBitmap, DOCUMENT_STATUS_COUNT> status_documents_;
+    std::array<int, DOCUMENT_STATUS_COUNT> status_document_counts_{};
+    //количество слов документа без стоп слов, точно сохраняется в снимок
+    std::vector<uint32_t> document_lengths_;
+    //1 / количество слов документа без стоп слов (0 для документа только из стоп-слов): замороженный индекс
+    //хранит целые числа вхождений, TF = число вхождений * обратная длина
+    std::vector<double> inverse_document_lengths_;
     //структура сохраняющая стоп слова
     const std::set<std::string, std::less<>> stop_words_;
-    //структура сохраняющая частоту слов в документе
-    std::map<int, std::map<std::string_view, double>> word_freqs_;
-    //структура которая сопоставляет каждому слову словарь «документ → TF»
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    //совершенный хэш тех же стоп слов, по нему идет проверка слов документов и запросов
+    const StopWordFilter stop_word_filter_;
+    //словарь слов индекса, тексты документов целиком больше не хранятся
+    TermDictionary dictionary_;
+    //прямой индекс: id различных слов документа и их TF, по нему удаляется документ из индекса
+    ForwardIndex forward_index_;
+    //частоты слов документов по внутренним номерам, слова указывают в словарь. строятся по прямому индексу
+    //при первом вызове GetWordFrequencies для документа, поэтому загрузка снимка их не строит
+    mutable std::unordered_map<int, std::map<std::string_view, double>> word_freqs_;
+    mutable std::unique_ptr<std::mutex> word_freqs_mutex_ = std::make_unique<std::mutex>();
+    //изменяемый хвост индекса: каждому id слова словарь «внутренний номер документа → TF» для документов
+    //с номерами от frozen_ordinal_count_. до заморозки в хвосте весь индекс
+    std::vector<std::map<int, double>> word_to_document_freqs_;
+    //наибольший TF слова среди документов — вместе с IDF дает верхнюю границу вклада слова в релевантность.
+    //удаление документов границу не уменьшает, точной она становится при заморозке
+    std::vector<double> max_term_freqs_;
+    //замороженная часть индекса: постинги документов с номерами меньше frozen_ordinal_count_,
+    //номер слота совпадает с id слова, у слов, появившихся после заморозки, слотов нет
+    FrozenIndex frozen_index_;
+    int frozen_ordinal_count_ = 0;
+    bool is_frozen_ = false;
+    //пул накопителей релевантности, переиспользуется между запросами
+    mutable ScoreAccumulatorPool accumulator_pool_;
+    //количество живых документов со словом и логарифмы количества документов и документной частоты:
+    //IDF = log(N / df) = log(N) - log(df) считается без аллокаций и без вызова log на запросе
+    std::vector<int> document_freqs_;
+    double log_document_count_ = 0.0;
+    std::vector<double> log_document_freqs_;
+    //отложенное удаление: битовая карта и список помеченных документов по внутренним номерам
+    std::vector<bool> dead_documents_;
+    std::vector<int> dead_ordinals_;
+    bool use_tombstones_ = false;
+    double max_dead_ratio_ = DEFAULT_MAX_DEAD_RATIO;
+    //версия индекса: растет при каждом изменении, от которого зависит выдача, по ней устаревает кэш запросов
+    uint64_t index_version_ = 0;
+    //поколение словаря: растет, когда уплотнение перенумеровывает слова
+    uint64_t dictionary_generation_ = 0;
+    //кэш результатов запросов с фильтром по статусу, выключен, пока не вызван EnableQueryCache
+    mutable QueryResultCache query_cache_;
+    //собственный пул потоков пакетных запросов, nullptr — общий пул процесса
+    std::shared_ptr<const ThreadPool> thread_pool_;
+
+    //курсор по постингам слова для поиска по документам в порядке их номеров,
+    //помеченные удаленными документы пропускаются
+    class PostingCursor {
+    public:
+        PostingCursor(const SearchServer& search_server, TermId term, int first_ordinal);
+
+        bool IsEnd() const;
+        int GetOrdinal() const;
+        double GetTermFreq() const;
+        //метод переходит к следующему постингу
+        void Next();
+        //метод переходит к первому постингу с номером документа не меньше ordinal
+        void Seek(int ordinal);
+        //метод возвращает границу TF слова для документов от ordinal до конца блока, в котором он лежал бы
+        FrozenIndex::BlockBound PeekBlock(int ordinal) const;
+
+    private:
+        const SearchServer* search_server_;
+        TermId term_;
+        std::optional<FrozenIndex::Cursor> frozen_cursor_;
+        const std::map<int, double>* document_freqs_ = nullptr;
+        std::map<int, double>::const_iterator it_;
+
+        //метод переходит к следующему постингу, не пропуская помеченных документов.
+        //после последнего постинга замороженной части курсор переходит в хвост
+        void Advance();
+        //метод пропускает помеченные удаленными документы
+        void SkipDead();
+    };
+
+    //метод переводит TF слова в документе в число вхождений
+    uint32_t GetTermCount(int ordinal, double term_freq) const;
+    //метод изменяет количество документов со словом и пересчитывает log(df)
+    void ChangeDocumentFreq(TermId term, int delta);
+    //метод расширяет структуры, адресуемые id слова, до term_count слов
+    void ReserveTerms(size_t term_count);
+    //метод пересчитывает log(N) после изменения количества документов и увеличивает версию индекса
+    void UpdateDocumentCount();
+    //метод возвращает пул пакетных запросов: собственный или общий пул процесса
+    const ThreadPool& GetThreadPool() const;
+
+    //метод возвращает постинги слова в изменяемом хвосте, у слова без них — пустой словарь
+    const std::map<int, double>& GetTailPostings(TermId term) const;
+    //метод проверяет, есть ли у слова список постингов в замороженной части
+    bool HasFrozenPostings(TermId term) const;
+
+    //метод дописывает статус нового документа в таблицу документов и в битовую карту статуса
+    void AddDocumentStatus(DocumentStatus status);
+
+    //метод возвращает внутренний номер документа, для неизвестного id бросает out_of_range
+    int GetOrdinal(int document_id) const;
+    //метод удаляет документ из таблицы документов и возвращает его внутренний номер
+    int EraseDocumentData(int document_id);
+    //метод помечает документ удаленным, не изменяя списков постингов. уплотнение не запускается
+    void MarkDocumentDead(int document_id);
+    //метод уплотняет индекс, если доля свободных номеров документов превышает max_dead_ratio_
+    void CompactIfSparse();
+    //метод нумерует живые документы подряд в порядке их номеров, номера удаленных документов -1
+    std::vector<int> ComputeLiveOrdinals() const;
+    //метод добавляет пакет документов, сгруппировав их постинги по словам
+    template <typename ExecutionPolicy>
+    void AddDocumentBatch(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents);
+    //метод удаляет пакет документов, сгруппировав их постинги по словам
+    template <typename ExecutionPolicy>
+    void RemoveDocumentBatch(const ExecutionPolicy& policy, const std::vector<int>& document_ids);
+
+    //метод обходит постинги слова в любом из состояний индекса, помеченные документы пропускаются
+    template <typename Function>
+    void ForEachPosting(TermId term, Function function) const;
+    //метод обходит постинги слова с внутренними номерами документов из [first_ordinal, last_ordinal)
+    template <typename Function>
+    void ForEachPosting(TermId term, int first_ordinal, int last_ordinal, Function function) const;
+    //метод возвращает количество живых документов со словом
+    size_t GetDocumentFreq(TermId term) const;
+    //метод проверяет, содержит ли документ с внутренним номером слово
+    bool HasPosting(TermId term, int ordinal) const;
+
+    //фильтр, пропускающий все живые документы: им заменяется фильтр по статусу, который есть у всех документов
+    struct AllDocumentsFilter {
+        bool operator()(int /*document_id*/, DocumentStatus /*document_status*/, int /*rating*/) const {
+            return true;
+        }
+    };
+    //метод проверяет документ фильтром. фильтр по статусу проверяется по битовой карте, а фильтр
+    //всех документов не проверяется вовсе
+    template <typename DocumentPredicate>
+    bool IsDocumentAccepted(const DocumentPredicate& document_predicate, int ordinal) const;
+    //метод возвращает первый документ из [ordinal, last_ordinal), который может пройти фильтр
+    template <typename DocumentPredicate>
+    int FindNextAcceptedDocument(const DocumentPredicate& document_predicate, int ordinal, int last_ordinal) const;
 
     //метод проверки на стоп слово
     bool IsStopWord(std::string_view word) const;
@@ -106,11 +472,13 @@ private:
     //метод проверки на валидность слов
     static bool IsValidWord(std::string_view word);
 
-    //метод очищающий запрос от стоп слов
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    //метод очищающий текст от стоп слов, слова пишутся в переиспользуемый буфер words
+    void SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const;
 
     //метод расчитывающий рейтинг слов
     static int ComputeAverageRating(const std::vector<int> &ratings);
+    //метод возвращает обратную длину документа, у документа без слов она 0
+    static double ComputeInverseLength(size_t word_count);
 
     struct QueryWord {
         std::string_view data;
@@ -118,68 +486,295 @@ private:
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(std::string_view text) const;
+    //is_valid_text сообщает, что разбиение уже проверило текст запроса на управляющие символы
+    QueryWord ParseQueryWord(std::string_view text, bool is_valid_text) const;
 
-    //изменил структуру хранения слов с set на vector
-    //для возможности итерироватся методом unique, и удалять дубликаты
-    struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+    //буфер слов разбираемого запроса, свой у каждого потока
+    static std::vector<std::string_view>& GetQueryWordBuffer();
+
+    //буфер IDF плюс-слов запроса из пула своего потока: поиск не выделяет память под IDF.
+    //поток, ждущий вложенный ParallelFor, выполняет чужие запросы, поэтому у каждого поиска
+    //на потоке свой буфер, который возвращается в пул, когда поиск закончен
+    class InverseDocumentFreqBuffer {
+    public:
+        InverseDocumentFreqBuffer();
+        ~InverseDocumentFreqBuffer();
+        InverseDocumentFreqBuffer(const InverseDocumentFreqBuffer&) = delete;
+        InverseDocumentFreqBuffer& operator=(const InverseDocumentFreqBuffer&) = delete;
+
+        std::vector<double>& Get();
+
+    private:
+        std::vector<double> buffer_;
+
+        static std::vector<std::vector<double>>& GetPool();
     };
+    //метод убирает повторы слов запроса, слова упорядочиваются по id
+    static void RemoveDuplicateTerms(QueryTerms& terms);
+    //метод возвращает разобранный скомпилированный запрос, дополнив его словами, попавшими в словарь после компиляции
+    Query ResolveQuery(const CompiledQuery& compiled_query) const;
+    //метод проверяет, что скомпилированный запрос можно выполнять без ResolveQuery
+    bool IsQueryResolved(const CompiledQuery& compiled_query) const;
+    //метод поиска топ докуметов по разобранному запросу
+    template <typename DocumentPredicate, typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy&, const Query& query, DocumentPredicate document_predicate,
+                                           size_t max_count) const;
+    //метод возвращает ключ кэша запросов для разобранного запроса
+    static QueryCacheKey MakeQueryCacheKey(const Query& query, DocumentStatus status, size_t max_count);
+    //метод поиска топ докуметов с заданным статусом по разобранному запросу, при включенном кэше запросов
+    //результат берется из него
+    template <typename Policy>
+    std::vector<Document> FindTopDocumentsWithStatus(const Policy&, const Query& query, DocumentStatus status,
+                                                     size_t max_count) const;
 
     //метод для парсинга плюс/минус слов
     Query ParseQuery(std::string_view  text) const;
     Query ParseQuery(const std::execution::sequenced_policy&, std::string_view text) const ;
-    //паралельный метод для парсинга плюс/минус слов, с булевым флагом
-    Query ParseQuery(bool flag, std::string_view text) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string &word) const;
+    double ComputeWordInverseDocumentFreq(TermId term) const;
+    //метод записывает в inverse_document_freqs IDF плюс-слов запроса в их порядке, для слов без живых документов 0
+    void ComputeInverseDocumentFreqs(const Query& query, std::vector<double>& inverse_document_freqs) const;
 
-    //метод поиска всех документов
+    //метод поиска всех документов с фильтром: фильтр по статусу, которого нет ни у одного документа,
+    //сразу дает пустой результат, а фильтр по статусу всех документов заменяется на AllDocumentsFilter
+    template <typename DocumentPredicate, typename Policy>
+    std::vector<Document> FindFilteredDocuments(const Policy& policy, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                                DocumentPredicate document_predicate, size_t max_count) const;
+    //метод поиска всех документов, возвращает max_count лучших из них по убыванию.
+    //inverse_document_freqs задает IDF каждого плюс-слова запроса
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindAllDocuments(const Query& query, const std::vector<double>& inverse_document_freqs,
+                                           DocumentPredicate document_predicate, size_t max_count) const;
     //однопоточный метод поиска всех документов
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy, const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                           DocumentPredicate document_predicate, size_t max_count) const;
     //паралельный метод поиска всех документов
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                           DocumentPredicate document_predicate, size_t max_count) const;
+    //метод поиска всех документов на пуле потоков
+    template <typename DocumentPredicate>
+    std::vector<Document> FindAllDocuments(const ThreadPool& pool, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                           DocumentPredicate document_predicate, size_t max_count) const;
+    //метод поиска всех документов по slice_count отрезкам номеров документов,
+    //for_each_slice(slice_count, function) вызывает function(slice) для каждого отрезка
+    template <typename DocumentPredicate, typename ForEachSlice>
+    std::vector<Document> FindSlicedDocuments(const Query& query, const std::vector<double>& inverse_document_freqs,
+                                              DocumentPredicate document_predicate, size_t max_count,
+                                              size_t slice_count, ForEachSlice for_each_slice) const;
+
+    //метод поиска по документам с отсечением (MaxScore) на отрезке номеров [first_ordinal, last_ordinal):
+    //списки постингов обходятся одновременно, документ оценивается целиком, и документы,
+    //которые по верхним границам вкладов слов не могут войти в отбор, пропускаются
+    template <typename DocumentPredicate>
+    void FindPrunedDocuments(const Query& query, const std::vector<double>& inverse_document_freqs,
+                             DocumentPredicate document_predicate, int first_ordinal, int last_ordinal,
+                             TopDocuments& top_documents) const;
+    //метод создает курсоры по словам, начиная с документа first_ordinal
+    std::vector<PostingCursor> MakePostingCursors(const QueryTerms& terms, int first_ordinal) const;
+    //метод проверяет переходом курсоров, содержит ли документ хотя бы одно из их слов
+    static bool ContainsAny(std::vector<PostingCursor>& cursors, int ordinal);
+    //метод проверяет, стоит ли искать с отсечением: слов должно быть несколько, а отбор меньше отрезка
+    static bool IsPruningUseful(const Query& query, size_t max_count, size_t document_count);
+
+    //слово пакетного поиска с общими словами и запрос группы, в который оно входит
+    struct TermUse {
+        TermId term;
+        uint32_t query;
+        double inverse_document_freq;
+    };
+    //метод ищет документы запросов группы на отрезке номеров [first_ordinal, last_ordinal), каждый список
+    //постингов отрезка читается один раз. plus_uses и minus_uses упорядочены по id слова
+    void FindSharedTermDocuments(const std::vector<TermUse>& plus_uses, const std::vector<TermUse>& minus_uses,
+                                 size_t query_count, DocumentStatus status, int first_ordinal, int last_ordinal,
+                                 std::vector<TopDocuments>& top_documents) const;
+
+    //метод отбирает лучшие документы накопителя
+    void SelectTopDocuments(const ScoreAccumulator& accumulator, TopDocuments& top_documents) const;
+    //метод определяет, на сколько отрезков номеров документов делить параллельный запрос на thread_count потоках
+    size_t GetSliceCount(const Query& query, size_t thread_count) const;
 };
 
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer& stop_words)
-        : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+        : stop_words_(MakeUniqueNonEmptyStrings(stop_words)), stop_word_filter_(stop_words_)
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid");
     }
 }
+
+template <size_t N>
+SearchServer::SearchServer(const StaticStopWordFilter<N> &stop_words)
+        : stop_words_(MakeUniqueNonEmptyStrings(stop_words.GetWords())), stop_word_filter_(stop_words)
+{
+    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+        throw std::invalid_argument("Some of stop words are invalid");
+    }
+}
+
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_count);
+}
+
+template<typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentPredicate document_predicate, size_t max_count) const {
+    return FindTopDocuments(policy, ParseQuery(raw_query), document_predicate, max_count);
 }
 
 template<typename DocumentPredicate, typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const CompiledQuery &query, DocumentPredicate document_predicate, size_t max_count) const {
+    if (IsQueryResolved(query)) {
+        return FindTopDocuments(policy, query.query_, document_predicate, max_count);
+    }
+    return FindTopDocuments(policy, ResolveQuery(query), document_predicate, max_count);
+}
+
+//статус проверяется фильтром DocumentStatusFilter, как в поиске по тексту запроса, и результат берется из кэша запросов
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const CompiledQuery &query, DocumentStatus status, size_t max_count) const {
+    if (IsQueryResolved(query)) {
+        return FindTopDocumentsWithStatus(policy, query.query_, status, max_count);
+    }
+    return FindTopDocumentsWithStatus(policy, ResolveQuery(query), status, max_count);
+}
+
+template<typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const Query &query, DocumentPredicate document_predicate, size_t max_count) const {
+    //отбор топа идет прямо по накопленной релевантности, полной сортировки совпадений нет
+    InverseDocumentFreqBuffer inverse_document_freqs;
+    ComputeInverseDocumentFreqs(query, inverse_document_freqs.Get());
+    return FindFilteredDocuments(policy, query, inverse_document_freqs.Get(), document_predicate, max_count);
+}
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::FindFilteredDocuments(const Policy& policy, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                                          DocumentPredicate document_predicate, size_t max_count) const {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>) {
+        const int status_document_count = status_document_counts_[static_cast<size_t>(document_predicate.status)];
+        if (status_document_count == 0) {
+            return {};
+        }
+        if (status_document_count == GetDocumentCount()) {
+            return FindAllDocuments(policy, query, inverse_document_freqs, AllDocumentsFilter{}, max_count);
+        }
+    }
+    return FindAllDocuments(policy, query, inverse_document_freqs, document_predicate, max_count);
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::IsDocumentAccepted(const DocumentPredicate& document_predicate, int ordinal) const {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>) {
+        return status_documents_[static_cast<size_t>(document_predicate.status)].Test(ordinal);
+    } else if constexpr (std::is_same_v<DocumentPredicate, AllDocumentsFilter>) {
+        return true;
+    } else if constexpr (IsExcludingDocumentsFilter<DocumentPredicate>::value) {
+        return !document_predicate.excluded_documents->Test(ordinal) && IsDocumentAccepted(document_predicate.document_predicate, ordinal);
+    } else {
+        return document_predicate(ordinal_to_id_[ordinal], document_statuses_[ordinal], document_ratings_[ordinal]);
+    }
+}
+
+template <typename DocumentPredicate>
+int SearchServer::FindNextAcceptedDocument(const DocumentPredicate& document_predicate, int ordinal, int last_ordinal) const {
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>) {
+        return status_documents_[static_cast<size_t>(document_predicate.status)].FindNext(ordinal, last_ordinal);
+    } else if constexpr (IsExcludingDocumentsFilter<DocumentPredicate>::value) {
+        //исключенные документы редки, поэтому они пропускаются по одному поверх внутреннего фильтра
+        ordinal = FindNextAcceptedDocument(document_predicate.document_predicate, ordinal, last_ordinal);
+        while (ordinal < last_ordinal && document_predicate.excluded_documents->Test(ordinal)) {
+            ordinal = FindNextAcceptedDocument(document_predicate.document_predicate, ordinal + 1, last_ordinal);
+        }
+        return ordinal;
+    } else {
+        //произвольный фильтр проверяется только на самом документе
+        return ordinal;
+    }
+}
+
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocumentsWithStatus(const Policy &policy, const Query &query, DocumentStatus status,
+                                                               size_t max_count) const {
+    const auto find_documents = [&]() {
+        return FindTopDocuments(policy, query, DocumentStatusFilter{status}, max_count);
+    };
+    if (query_cache_.GetCapacity() == 0) {
+        return find_documents();
+    }
+    QueryCacheKey key = MakeQueryCacheKey(query, status, max_count);
+    if (auto documents = query_cache_.Find(key, index_version_)) {
+        return std::move(*documents);
+    }
+    std::vector<Document> documents = find_documents();
+    query_cache_.Insert(std::move(key), index_version_, documents);
+    return documents;
+}
+
+template <typename DocumentPredicate, typename Policy, typename InverseDocumentFreq>
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     size_t max_count, InverseDocumentFreq inverse_document_freq) const {
     const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < PRECISION) {
-                 return lhs.rating > rhs.rating;
-             }
-             return lhs.relevance > rhs.relevance;
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    InverseDocumentFreqBuffer buffer;
+    std::vector<double>& inverse_document_freqs = buffer.Get();
+    inverse_document_freqs.assign(query.plus_words.size(), 0.0);
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        if (GetDocumentFreq(query.plus_words[i]) != 0) {
+            inverse_document_freqs[i] = inverse_document_freq(dictionary_.GetWord(query.plus_words[i]));
+        }
     }
-    return matched_documents;
+    return FindFilteredDocuments(policy, query, inverse_document_freqs, document_predicate, max_count);
 }
 
 template <typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-        return document_status == status;
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentStatus status, size_t max_count) const {
+    return FindTopDocumentsWithStatus(policy, ParseQuery(raw_query), status, max_count);
+}
+
+template <typename Callback>
+void SearchServer::FindTopDocumentsBatchStreamed(const std::vector<std::string_view>& raw_queries, Callback callback,
+                                                 QueryResultOrder order, DocumentStatus status, size_t max_count) const {
+    const ThreadPool& pool = GetThreadPool();
+    std::mutex mutex;
+    if (order == QueryResultOrder::COMPLETION_ORDER) {
+        pool.ParallelFor(raw_queries.size(), [&](size_t index) {
+            std::vector<Document> documents = FindTopDocuments(pool, raw_queries[index], status, max_count);
+            std::lock_guard guard(mutex);
+            callback(index, std::move(documents));
+        });
+        return;
+    }
+    //готовые результаты ждут, пока не будут отданы все предыдущие. отдает их тот поток, который застал
+    //очередь свободной, остальные только складывают свои результаты и берут следующий запрос.
+    //мьютекс защищает только ready, next_index и is_emitting: ни вычисление запроса, ни callback под ним не идут,
+    //поэтому медленный потребитель задерживает лишь поток, отдающий результаты, но не остальные запросы
+    std::vector<std::optional<std::vector<Document>>> ready(raw_queries.size());
+    size_t next_index = 0;
+    bool is_emitting = false;
+    pool.ParallelFor(raw_queries.size(), [&](size_t index) {
+        std::vector<Document> documents = FindTopDocuments(pool, raw_queries[index], status, max_count);
+        std::unique_lock lock(mutex);
+        ready[index] = std::move(documents);
+        if (is_emitting) {
+            return;
+        }
+        is_emitting = true;
+        while (next_index < ready.size() && ready[next_index]) {
+            const size_t emit_index = next_index++;
+            std::vector<Document> emit_documents = std::move(*ready[emit_index]);
+            ready[emit_index].reset();
+            lock.unlock();
+            try {
+                callback(emit_index, std::move(emit_documents));
+            } catch (...) {
+                lock.lock();
+                is_emitting = false;
+                throw;
+            }
+            lock.lock();
+        }
+        is_emitting = false;
     });
 }
 
@@ -188,71 +783,381 @@ std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, std::
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query &query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename ExecutionPolicy>
+void SearchServer::AddDocumentBatch(const ExecutionPolicy& policy, const std::vector<NewDocument>& documents) {
+    std::set<int> batch_ids;
+    for (const NewDocument& document : documents) {
+        if (document.id < 0 || document_ordinals_.count(document.id) > 0 || !batch_ids.insert(document.id).second) {
+            throw std::invalid_argument("Invalid document_id");
         }
-        std::string word_str(word);
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word_str);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    }
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+
+    //разбиение на слова и расчет TF независимы для документов и идут параллельно.
+    //исключение из параллельного алгоритма вызвало бы terminate, поэтому ошибки собираются
+    std::vector<std::vector<std::pair<std::string_view, double>>> document_word_freqs(documents.size());
+    std::vector<size_t> lengths(documents.size());
+    std::vector<std::exception_ptr> errors(documents.size());
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+        try {
+            //буфер слов свой у каждого потока и переиспользуется между документами
+            thread_local std::vector<std::string_view> words;
+            SplitIntoWordsNoStop(documents[index].text, words);
+            const double inv_word_count = ComputeInverseLength(words.size());
+            lengths[index] = words.size();
+            std::sort(words.begin(), words.end());
+            auto& word_freqs = document_word_freqs[index];
+            for (const std::string_view word : words) {
+                if (word_freqs.empty() || word_freqs.back().first != word) {
+                    word_freqs.emplace_back(word, 0.0);
+                }
+                word_freqs.back().second += inv_word_count;
             }
+        } catch (...) {
+            errors[index] = std::current_exception();
+        }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    //словарь пополняется последовательно, дальше вся работа идет по id слов
+    const int first_ordinal = static_cast<int>(ordinal_to_id_.size());
+    std::vector<std::vector<TermId>> batch_terms(documents.size());
+    std::vector<size_t> posting_offsets(documents.size() + 1, 0);
+    for (size_t index = 0; index < documents.size(); ++index) {
+        const NewDocument& document = documents[index];
+        for (const auto& [word, _] : document_word_freqs[index]) {
+            batch_terms[index].push_back(dictionary_.Intern(word));
+        }
+        posting_offsets[index + 1] = posting_offsets[index] + batch_terms[index].size();
+        ordinal_to_id_.push_back(document.id);
+        dead_documents_.push_back(false);
+        document_ratings_.push_back(ComputeAverageRating(document.ratings));
+        AddDocumentStatus(document.status);
+        document_lengths_.push_back(static_cast<uint32_t>(lengths[index]));
+        inverse_document_lengths_.push_back(ComputeInverseLength(lengths[index]));
+        document_ordinals_.emplace(document.id, first_ordinal + static_cast<int>(index));
+        document_id_.insert(document.id);
+    }
+    ReserveTerms(dictionary_.GetSize());
+
+    //слова документов упорядочиваются по id для прямого индекса, постинги пакета выкладываются в общий массив
+    std::vector<std::tuple<TermId, int, double>> postings(posting_offsets.back());
+    std::vector<std::vector<std::pair<TermId, double>>> batch_term_freqs(documents.size());
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+        const int ordinal = first_ordinal + static_cast<int>(index);
+        const auto& word_freqs = document_word_freqs[index];
+        const auto& terms = batch_terms[index];
+        auto& term_freqs = batch_term_freqs[index];
+        for (size_t i = 0; i < terms.size(); ++i) {
+            postings[posting_offsets[index] + i] = {terms[i], ordinal, word_freqs[i].second};
+            term_freqs.emplace_back(terms[i], word_freqs[i].second);
+        }
+        std::sort(term_freqs.begin(), term_freqs.end());
+    });
+    for (const auto& term_freqs : batch_term_freqs) {
+        forward_index_.AddDocument(term_freqs);
+    }
+
+    //постинги группируются по словам, каждая группа дописывается в конец своего списка
+    std::sort(policy, postings.begin(), postings.end());
+    std::vector<size_t> group_begins;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (i == 0 || std::get<0>(postings[i]) != std::get<0>(postings[i - 1])) {
+            group_begins.push_back(i);
         }
     }
-    for ( std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    std::for_each(policy, group_begins.begin(), group_begins.end(), [&](size_t begin) {
+        const TermId term = std::get<0>(postings[begin]);
+        auto& document_freqs = word_to_document_freqs_[term];
+        int added_count = 0;
+        for (size_t i = begin; i < postings.size() && std::get<0>(postings[i]) == term; ++i) {
+            document_freqs.emplace_hint(document_freqs.end(), std::get<1>(postings[i]), std::get<2>(postings[i]));
+            max_term_freqs_[term] = std::max(max_term_freqs_[term], std::get<2>(postings[i]));
+            ++added_count;
+        }
+        ChangeDocumentFreq(term, added_count);
+    });
+    UpdateDocumentCount();
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::RemoveDocumentBatch(const ExecutionPolicy& policy, const std::vector<int>& document_ids) {
+    //пары «слово — документ» из прямого индекса удаляемых документов хвоста.
+    //документы замороженной части и при отложенном удалении только помечаются
+    std::vector<std::pair<TermId, int>> term_ordinals;
+    for (const int document_id : document_ids) {
+        const auto it = document_ordinals_.find(document_id);
+        if (it == document_ordinals_.end()) {
+            continue;
+        }
+        if (use_tombstones_ || it->second < frozen_ordinal_count_) {
+            MarkDocumentDead(document_id);
             continue;
         }
-        for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        const int ordinal = EraseDocumentData(document_id);
+        for (const TermId term : forward_index_.GetDocument(ordinal)) {
+            term_ordinals.emplace_back(term, ordinal);
         }
     }
+    std::sort(policy, term_ordinals.begin(), term_ordinals.end());
 
-    std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+    std::vector<size_t> group_begins;
+    for (size_t i = 0; i < term_ordinals.size(); ++i) {
+        if (i == 0 || term_ordinals[i].first != term_ordinals[i - 1].first) {
+            group_begins.push_back(i);
+        }
     }
-    return matched_documents;
+    //каждая группа относится к своему слову, поэтому группы не пересекаются по спискам постингов
+    std::for_each(policy, group_begins.begin(), group_begins.end(), [&](size_t begin) {
+        const TermId term = term_ordinals[begin].first;
+        auto& document_freqs = word_to_document_freqs_[term];
+        int removed_count = 0;
+        for (size_t i = begin; i < term_ordinals.size() && term_ordinals[i].first == term; ++i) {
+            document_freqs.erase(term_ordinals[i].second);
+            ++removed_count;
+        }
+        ChangeDocumentFreq(term, -removed_count);
+    });
+    CompactIfSparse();
+}
+
+template <typename Function>
+void SearchServer::ForEachPosting(TermId term, Function function) const {
+    ForEachPosting(term, 0, std::numeric_limits<int>::max(), function);
+}
+
+template <typename Function>
+void SearchServer::ForEachPosting(TermId term, int first_ordinal, int last_ordinal, Function function) const {
+    //постинги отсортированы по номеру документа, поэтому начало отрезка ищется бинарным поиском.
+    //номера документов хвоста больше номеров замороженной части, и хвост обходится после нее
+    if (first_ordinal < frozen_ordinal_count_ && HasFrozenPostings(term)) {
+        frozen_index_.ForEach(term, first_ordinal, std::min(last_ordinal, frozen_ordinal_count_), [&](int ordinal, uint32_t term_count) {
+            if (dead_ordinals_.empty() || !dead_documents_[ordinal]) {
+                function(ordinal, term_count * inverse_document_lengths_[ordinal]);
+            }
+        });
+    }
+    const auto& document_freqs = GetTailPostings(term);
+    for (auto it = document_freqs.lower_bound(first_ordinal); it != document_freqs.end() && it->first < last_ordinal; ++it) {
+        if (dead_ordinals_.empty() || !dead_documents_[it->first]) {
+            function(it->first, it->second);
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const Query &query, const std::vector<double>& inverse_document_freqs,
+                                                     DocumentPredicate document_predicate, size_t max_count) const {
+    if (IsPruningUseful(query, max_count, ordinal_to_id_.size())) {
+        TopDocuments top_documents(max_count);
+        FindPrunedDocuments(query, inverse_document_freqs, document_predicate, 0, static_cast<int>(ordinal_to_id_.size()), top_documents);
+        return top_documents.Release();
+    }
+    //релевантность копится по внутренним номерам, внешний id нужен только в результате
+    auto document_to_relevance = accumulator_pool_.Acquire(ordinal_to_id_.size());
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const double inverse_document_freq = inverse_document_freqs[i];
+        //минус-слова не обходятся целиком: их курсоры переходят к документам плюс-слова по скип-указателям блоков
+        auto minus_cursors = MakePostingCursors(query.minus_words, 0);
+        ForEachPosting(query.plus_words[i], [&](int ordinal, double term_freq) {
+            if (ContainsAny(minus_cursors, ordinal)) {
+                document_to_relevance->Exclude(ordinal);
+            } else if (IsDocumentAccepted(document_predicate, ordinal)) {
+                document_to_relevance->Add(ordinal, term_freq * inverse_document_freq);
+            }
+        });
+    }
+    TopDocuments top_documents(max_count);
+    SelectTopDocuments(*document_to_relevance, top_documents);
+    return top_documents.Release();
 }
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy, const Query& query, DocumentPredicate document_predicate) const {
-    return SearchServer::FindAllDocuments(query, document_predicate);}
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                                     DocumentPredicate document_predicate, size_t max_count) const {
+    return SearchServer::FindAllDocuments(query, inverse_document_freqs, document_predicate, max_count);}
+
 
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                                     DocumentPredicate document_predicate, size_t max_count) const {
+    return FindSlicedDocuments(query, inverse_document_freqs, document_predicate, max_count, GetSliceCount(query, CPU_THREAD),
+                               [](size_t slice_count, auto function) {
+        std::vector<size_t> slice_indexes(slice_count);
+        std::iota(slice_indexes.begin(), slice_indexes.end(), 0);
+        std::for_each(std::execution::par, slice_indexes.begin(), slice_indexes.end(), function);
+    });
+}
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(CPU_THREAD);
-    for_each(
-            std::execution::par,
-            query.plus_words.begin(), query.plus_words.end(),
-            [&, document_predicate](auto word ) {
-                if (word_to_document_freqs_.count(word) != 0) {
-                    std::string word_str(word);
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word_str);
-                    for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating))
-                        {
-                            document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+std::vector<Document> SearchServer::FindAllDocuments(const ThreadPool& pool, const Query& query, const std::vector<double>& inverse_document_freqs,
+                                                     DocumentPredicate document_predicate, size_t max_count) const {
+    //отрезки тяжелого запроса ставятся в очередь того же пула, что и остальные запросы пакета
+    return FindSlicedDocuments(query, inverse_document_freqs, document_predicate, max_count, GetSliceCount(query, pool.GetThreadCount()),
+                               [&pool](size_t slice_count, auto function) {
+        pool.ParallelFor(slice_count, function);
+    });
+}
+
+template <typename DocumentPredicate, typename ForEachSlice>
+std::vector<Document> SearchServer::FindSlicedDocuments(const Query& query, const std::vector<double>& inverse_document_freqs,
+                                                        DocumentPredicate document_predicate, size_t max_count,
+                                                        size_t slice_count, ForEachSlice for_each_slice) const {
+    //пространство номеров документов делится на непересекающиеся отрезки, каждый поток
+    //обходит постинги всех слов только в своем отрезке и копит их в своем накопителе.
+    //блокировок нет, отрезки объединяются слиянием топов
+    const size_t document_count = ordinal_to_id_.size();
+    std::vector<TopDocuments> slice_tops(slice_count, TopDocuments(max_count));
+    for_each_slice(slice_count,
+            [&, document_predicate](size_t slice) {
+                const int first_ordinal = static_cast<int>(document_count * slice / slice_count);
+                const int last_ordinal = static_cast<int>(document_count * (slice + 1) / slice_count);
+                if (IsPruningUseful(query, max_count, last_ordinal - first_ordinal)) {
+                    FindPrunedDocuments(query, inverse_document_freqs, document_predicate, first_ordinal, last_ordinal, slice_tops[slice]);
+                    return;
+                }
+                auto document_to_relevance = accumulator_pool_.Acquire(last_ordinal - first_ordinal, first_ordinal);
+                for (size_t i = 0; i < query.plus_words.size(); ++i) {
+                    const double inverse_document_freq = inverse_document_freqs[i];
+                    auto minus_cursors = MakePostingCursors(query.minus_words, first_ordinal);
+                    ForEachPosting(query.plus_words[i], first_ordinal, last_ordinal, [&](int ordinal, double term_freq) {
+                        if (ContainsAny(minus_cursors, ordinal)) {
+                            document_to_relevance->Exclude(ordinal);
+                        } else if (IsDocumentAccepted(document_predicate, ordinal)) {
+                            document_to_relevance->Add(ordinal, term_freq * inverse_document_freq);
                         }
-                    }}});
-    for_each(
-            std::execution::par,
-            query.minus_words.begin(), query.minus_words.end(),
-            [&](auto word ) {if (word_to_document_freqs_.count(word) != 0){
-                for (const auto& [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance.Delete(document_id);
-                }}});
-    std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+                    });
+                }
+                SelectTopDocuments(*document_to_relevance, slice_tops[slice]);
+            });
+    TopDocuments top_documents(max_count);
+    for (const TopDocuments& slice_top : slice_tops) {
+        top_documents.Merge(slice_top);
+    }
+    return top_documents.Release();
+}
+template <typename DocumentPredicate>
+void SearchServer::FindPrunedDocuments(const Query& query, const std::vector<double>& inverse_document_freqs,
+                                       DocumentPredicate document_predicate, int first_ordinal, int last_ordinal,
+                                       TopDocuments& top_documents) const {
+    //слова упорядочиваются по возрастанию верхней границы вклада, prefix_bounds[j] — граница суммы вкладов первых j слов
+    const size_t term_count = query.plus_words.size();
+    std::vector<double> upper_bounds(term_count);
+    std::vector<size_t> order(term_count);
+    for (size_t i = 0; i < term_count; ++i) {
+        upper_bounds[i] = max_term_freqs_[query.plus_words[i]] * inverse_document_freqs[i];
+        order[i] = i;
     }
+    std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        return upper_bounds[lhs] < upper_bounds[rhs];
+    });
+    std::vector<double> prefix_bounds(term_count + 1, 0.0);
+    std::vector<PostingCursor> cursors;
+    cursors.reserve(term_count);
+    for (size_t j = 0; j < term_count; ++j) {
+        prefix_bounds[j + 1] = prefix_bounds[j] + upper_bounds[order[j]];
+        cursors.emplace_back(*this, query.plus_words[order[j]], first_ordinal);
+    }
+    auto minus_cursors = MakePostingCursors(query.minus_words, first_ordinal);
 
-    return matched_documents;
-}
\ No newline at end of file
+    //вклады слов в релевантность документа по порядку слов запроса: сумма в этом порядке
+    //совпадает до бита с релевантностью, накопленной по словам
+    std::vector<double> term_scores(term_count, 0.0);
+    double threshold = top_documents.GetThreshold() - PRUNING_MARGIN;
+    //первые passive_count слов вместе не дотягивают до порога, документы только с ними не рассматриваются
+    size_t passive_count = 0;
+    while (true) {
+        while (passive_count < term_count && prefix_bounds[passive_count + 1] < threshold) {
+            ++passive_count;
+        }
+        int ordinal = last_ordinal;
+        for (size_t j = passive_count; j < term_count; ++j) {
+            if (!cursors[j].IsEnd()) {
+                ordinal = std::min(ordinal, cursors[j].GetOrdinal());
+            }
+        }
+        if (passive_count == term_count || ordinal >= last_ordinal) {
+            break;
+        }
+        //документы, не проходящие фильтр по статусу, пропускаются отрезками по битовой карте статуса
+        const int accepted_ordinal = FindNextAcceptedDocument(document_predicate, ordinal, last_ordinal);
+        if (accepted_ordinal != ordinal) {
+            for (size_t j = passive_count; j < term_count; ++j) {
+                cursors[j].Seek(accepted_ordinal);
+            }
+            continue;
+        }
+        double upper_bound = prefix_bounds[passive_count];
+        for (size_t j = passive_count; j < term_count; ++j) {
+            if (!cursors[j].IsEnd() && cursors[j].GetOrdinal() == ordinal) {
+                upper_bound += upper_bounds[order[j]];
+            }
+        }
+        if (ordinal < frozen_ordinal_count_ && upper_bound >= threshold) {
+            //граница по блокам (Block-Max): вклад слова ограничен наибольшим TF блока, в котором лежал бы документ.
+            //она верна для всех документов до block_end, и если не дотягивает до порога, они пропускаются разом.
+            //у хвоста блоков нет, и граница совпала бы с уже проверенной
+            double block_bound = 0.0;
+            int block_end = last_ordinal - 1;
+            for (size_t j = 0; j < term_count; ++j) {
+                if (j >= passive_count && (cursors[j].IsEnd() || cursors[j].GetOrdinal() != ordinal)) {
+                    if (!cursors[j].IsEnd()) {
+                        block_end = std::min(block_end, cursors[j].GetOrdinal() - 1);
+                    }
+                    continue;
+                }
+                const FrozenIndex::BlockBound block = cursors[j].PeekBlock(ordinal);
+                block_bound += block.max_weight * inverse_document_freqs[order[j]];
+                block_end = std::min(block_end, block.last_ordinal);
+            }
+            if (block_bound < threshold) {
+                for (size_t j = passive_count; j < term_count; ++j) {
+                    cursors[j].Seek(block_end + 1);
+                }
+                continue;
+            }
+        }
+        if (upper_bound >= threshold && !ContainsAny(minus_cursors, ordinal)
+            && IsDocumentAccepted(document_predicate, ordinal)) {
+            double partial_score = 0.0;
+            for (size_t j = passive_count; j < term_count; ++j) {
+                if (!cursors[j].IsEnd() && cursors[j].GetOrdinal() == ordinal) {
+                    term_scores[order[j]] = cursors[j].GetTermFreq() * inverse_document_freqs[order[j]];
+                    partial_score += term_scores[order[j]];
+                }
+            }
+            //пассивные слова проверяются от больших границ к меньшим, пока документ может войти в отбор
+            bool is_pruned = false;
+            for (size_t j = passive_count; j-- > 0;) {
+                if (partial_score + prefix_bounds[j + 1] < threshold) {
+                    is_pruned = true;
+                    break;
+                }
+                cursors[j].Seek(ordinal);
+                if (!cursors[j].IsEnd() && cursors[j].GetOrdinal() == ordinal) {
+                    term_scores[order[j]] = cursors[j].GetTermFreq() * inverse_document_freqs[order[j]];
+                    partial_score += term_scores[order[j]];
+                }
+            }
+            if (!is_pruned) {
+                double relevance = 0.0;
+                for (const double term_score : term_scores) {
+                    relevance += term_score;
+                }
+                top_documents.Add({ordinal_to_id_[ordinal], relevance, document_ratings_[ordinal]});
+                threshold = top_documents.GetThreshold() - PRUNING_MARGIN;
+            }
+            std::fill(term_scores.begin(), term_scores.end(), 0.0);
+        }
+        for (size_t j = passive_count; j < term_count; ++j) {
+            if (!cursors[j].IsEnd() && cursors[j].GetOrdinal() == ordinal) {
+                cursors[j].Next();
+            }
+        }
+    }
+}
@@ -0,0 +1,209 @@
+#include "segmented_search_server.h"
+
+using namespace std;
+
+//метод возвращает количество живых документов сегмента
+int SegmentedSearchServer::Segment::GetDocumentCount() const {
+    return server->GetDocumentCount() - removed->GetCount();
+}
+
+//метод проверяет, есть ли живой документ в сегменте
+bool SegmentedSearchServer::Segment::HasDocument(int document_id) const {
+    return server->HasDocument(document_id) && !removed->Contains(document_id);
+}
+
+SegmentedSearchServer::SegmentedSearchServer(string_view stop_words_text, size_t buffer_capacity)
+        : stop_words_text_(stop_words_text), buffer_capacity_(max<size_t>(buffer_capacity, 1)),
+          buffer_(make_unique<SearchServer>(stop_words_text_)) {
+    Publish();
+    merger_ = thread([this] {
+        RunMerges();
+    });
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        lock_guard guard(writer_mutex_);
+        is_stopping_ = true;
+    }
+    merge_requested_.notify_all();
+    merger_.join();
+}
+
+//метод добавляет документ в буфер записи, id проверяется на уникальность по всем сегментам
+void SegmentedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int> &ratings) {
+    lock_guard guard(writer_mutex_);
+    for (const Segment &segment : segments_) {
+        if (segment.HasDocument(document_id)) {
+            throw invalid_argument("Invalid document_id");
+        }
+    }
+    buffer_->AddDocument(document_id, document, status, ratings);
+    if (static_cast<size_t>(buffer_->GetDocumentCount()) >= buffer_capacity_) {
+        FlushBuffer();
+    }
+    Publish();
+}
+
+//метод удаляет документ: в буфере сразу, в замороженном сегменте пометкой до ближайшего слияния.
+//сервер сегмента общий с опубликованными снимками, поэтому копируются только удаления сегмента
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    lock_guard guard(writer_mutex_);
+    if (buffer_->HasDocument(document_id)) {
+        buffer_->RemoveDocument(document_id);
+    } else {
+        const auto segment = find_if(segments_.begin(), segments_.end(), [document_id](const Segment &segment) {
+            return segment.HasDocument(document_id);
+        });
+        if (segment == segments_.end()) {
+            return;
+        }
+        auto removed = make_shared<RemovedDocuments>(*segment->removed);
+        removed->Add(*segment->server, {document_id});
+        segment->removed = move(removed);
+        //опустевший сегмент больше не нужен
+        if (segment->GetDocumentCount() == 0) {
+            segments_.erase(segment);
+        }
+    }
+    if (is_merging_) {
+        merge_removed_.push_back(document_id);
+    }
+    Publish();
+}
+
+//метод поиска топ докуметов с актуальным статусом
+vector<Document> SegmentedSearchServer::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+//метод возвращает количество документов во всех сегментах
+int SegmentedSearchServer::GetDocumentCount() const {
+    return LoadSnapshot()->document_count;
+}
+
+//метод возвращает количество сегментов вместе с буфером записи
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    return LoadSnapshot()->segments.size();
+}
+
+//метод замораживает непустой буфер записи в сегмент, не дожидаясь его заполнения
+void SegmentedSearchServer::Flush() {
+    lock_guard guard(writer_mutex_);
+    if (buffer_->GetDocumentCount() > 0) {
+        FlushBuffer();
+        Publish();
+    }
+}
+
+//метод ждет, пока фоновое слияние не объединит все сегменты, которые следует объединить
+void SegmentedSearchServer::WaitForMerges() {
+    unique_lock lock(writer_mutex_);
+    merge_finished_.wait(lock, [this] {
+        return !is_merging_ && SelectMergeSegments().empty();
+    });
+}
+
+shared_ptr<const SegmentedSearchServer::Snapshot> SegmentedSearchServer::LoadSnapshot() const {
+    return atomic_load(&snapshot_);
+}
+
+//метод публикует снимок: сегменты копируются указателями, а буфер — замороженной копией,
+//поэтому стоимость изменения ограничена размером буфера, а не индекса
+void SegmentedSearchServer::Publish() {
+    auto snapshot = make_shared<Snapshot>();
+    snapshot->segments = segments_;
+    auto buffer = make_shared<SearchServer>(*buffer_);
+    buffer->Freeze();
+    snapshot->segments.push_back({move(buffer), make_shared<const RemovedDocuments>()});
+    for (const Segment &segment : snapshot->segments) {
+        snapshot->document_count += segment.GetDocumentCount();
+    }
+    atomic_store(&snapshot_, shared_ptr<const Snapshot>(move(snapshot)));
+}
+
+//метод замораживает буфер в сегмент и открывает новый буфер
+void SegmentedSearchServer::FlushBuffer() {
+    buffer_->Freeze();
+    segments_.push_back({shared_ptr<const SearchServer>(move(buffer_)), make_shared<const RemovedDocuments>()});
+    buffer_ = make_unique<SearchServer>(stop_words_text_);
+    merge_requested_.notify_all();
+}
+
+//метод выбирает самые старые SEGMENT_MERGE_FACTOR сегментов первого уровня, на котором их набралось столько.
+//уровень сегмента — количество раз, которое его размер умещает SEGMENT_MERGE_FACTOR размеров буфера
+vector<SegmentedSearchServer::Segment> SegmentedSearchServer::SelectMergeSegments() const {
+    vector<vector<Segment>> tiers;
+    for (const Segment &segment : segments_) {
+        size_t tier = 0;
+        for (size_t limit = buffer_capacity_ * SEGMENT_MERGE_FACTOR;
+             static_cast<size_t>(segment.GetDocumentCount()) >= limit; limit *= SEGMENT_MERGE_FACTOR) {
+            ++tier;
+        }
+        if (tiers.size() <= tier) {
+            tiers.resize(tier + 1);
+        }
+        tiers[tier].push_back(segment);
+        if (tiers[tier].size() == SEGMENT_MERGE_FACTOR) {
+            return tiers[tier];
+        }
+    }
+    return {};
+}
+
+//метод заменяет сегменты списка: removed убираются, added встает на место последнего из них.
+//сегменты сравниваются по серверу: удаления из них за время слияния заменяют только копию удалений
+void SegmentedSearchServer::ReplaceSegments(const vector<Segment> &removed, optional<Segment> added) {
+    auto position = segments_.end();
+    for (auto it = segments_.begin(); it != segments_.end();) {
+        const bool is_removed = any_of(removed.begin(), removed.end(), [&it](const Segment &segment) {
+            return segment.server == it->server;
+        });
+        if (!is_removed) {
+            ++it;
+            continue;
+        }
+        position = segments_.erase(it);
+        it = position;
+    }
+    if (added) {
+        segments_.insert(position, move(*added));
+    }
+}
+
+//фоновое слияние: сегменты неизменяемы, поэтому читаются без блокировок, а поиск и запись их не ждут.
+//удаления, случившиеся за время слияния, отмечаются в удалениях результата перед его установкой
+void SegmentedSearchServer::RunMerges() {
+    unique_lock lock(writer_mutex_);
+    while (!is_stopping_) {
+        const auto sources = SelectMergeSegments();
+        if (sources.empty()) {
+            merge_finished_.notify_all();
+            merge_requested_.wait(lock);
+            continue;
+        }
+        is_merging_ = true;
+        lock.unlock();
+
+        auto merged = make_shared<SearchServer>(stop_words_text_);
+        for (const Segment &source : sources) {
+            merged->AddDocuments(*source.server);
+            const set<int> &source_removed = source.removed->GetDocumentIds();
+            merged->RemoveDocuments(vector<int>(source_removed.begin(), source_removed.end()));
+        }
+        merged->Compact();
+        merged->Freeze();
+
+        lock.lock();
+        auto removed = make_shared<RemovedDocuments>();
+        removed->Add(*merged, merge_removed_);
+        merge_removed_.clear();
+        optional<Segment> added;
+        if (merged->GetDocumentCount() > removed->GetCount()) {
+            added = Segment{move(merged), move(removed)};
+        }
+        ReplaceSegments(sources, move(added));
+        is_merging_ = false;
+        Publish();
+    }
+}
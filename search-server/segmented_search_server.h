@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cmath>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <algorithm>
+#include <execution>
+#include <string_view>
+#include <condition_variable>
+
+#include "search_server.h"
+#include "top_documents.h"
+#include "removed_documents.h"
+
+//количество документов в буфере записи, после которого он становится сегментом
+const size_t DEFAULT_SEGMENT_BUFFER_CAPACITY = 1024;
+//количество сегментов одного уровня, которые фоновое слияние объединяет в один
+const size_t SEGMENT_MERGE_FACTOR = 4;
+
+//составной поисковый сервер: неизменяемые замороженные сегменты и небольшой буфер записи.
+//новые документы попадают в буфер, заполненный буфер замораживается и становится сегментом,
+//а фоновый поток сливает по SEGMENT_MERGE_FACTOR сегментов одного уровня размера в один.
+//запрос обходит все сегменты с общим IDF всего индекса, поэтому результат совпадает с одним SearchServer.
+//поиск идет по неизменяемому снимку: сегментам и замороженной копии буфера, которые писатель публикует
+//атомарной заменой указателя после каждого изменения. поиск не берет блокировок и не ждет писателя,
+//а снимок освобождается подсчетом ссылок вместе с последним запросом, который его читает
+class SegmentedSearchServer {
+public:
+    explicit SegmentedSearchServer(std::string_view stop_words_text, size_t buffer_capacity = DEFAULT_SEGMENT_BUFFER_CAPACITY);
+    ~SegmentedSearchServer();
+
+    SegmentedSearchServer(const SegmentedSearchServer &) = delete;
+    SegmentedSearchServer &operator=(const SegmentedSearchServer &) = delete;
+
+    //метод добавляет документ в буфер записи, id проверяется на уникальность по всем сегментам
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+
+    //метод удаляет документ: в буфере сразу, в сегменте пометкой до ближайшего слияния
+    void RemoveDocument(int document_id);
+
+    //однопоточный/паралельный метод поиска топ докуметов с лямбдой, сегменты обходятся параллельно при par
+    template <typename DocumentPredicate, typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //однопоточный/паралельный метод поиска топ докуметов с заданным статусом
+    template <typename Policy>
+    std::vector<Document> FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    //метод поиска топ докуметов с актуальным статусом
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    //метод возвращает количество документов во всех сегментах
+    int GetDocumentCount() const;
+
+    //метод возвращает количество сегментов вместе с буфером записи
+    size_t GetSegmentCount() const;
+
+    //метод замораживает непустой буфер записи в сегмент, не дожидаясь его заполнения
+    void Flush();
+
+    //метод ждет, пока фоновое слияние не объединит все сегменты, которые следует объединить
+    void WaitForMerges();
+
+private:
+    //сегмент: замороженный сервер и его документы, удаленные после заморозки. сегмент не изменяется,
+    //удаление публикует сегмент с копией удалений, а сервер остается общим
+    struct Segment {
+        std::shared_ptr<const SearchServer> server;
+        std::shared_ptr<const RemovedDocuments> removed;
+
+        //метод возвращает количество живых документов сегмента
+        int GetDocumentCount() const;
+        //метод проверяет, есть ли живой документ в сегменте
+        bool HasDocument(int document_id) const;
+    };
+
+    //снимок для поиска: сегменты и замороженная копия буфера последней
+    struct Snapshot {
+        std::vector<Segment> segments;
+        int document_count = 0;
+    };
+
+    std::string stop_words_text_;
+    size_t buffer_capacity_;
+
+    //опубликованный снимок, читается и заменяется атомарно
+    std::shared_ptr<const Snapshot> snapshot_;
+
+    //writer_mutex_ упорядочивает изменения и установку результата слияния, сегменты и буфер
+    //изменяются только под ней
+    std::mutex writer_mutex_;
+    std::vector<Segment> segments_;
+    std::unique_ptr<SearchServer> buffer_;
+    std::condition_variable merge_requested_;
+    std::condition_variable merge_finished_;
+    bool is_merging_ = false;
+    bool is_stopping_ = false;
+    //id документов, удаленных во время слияния, удаляются и из его результата
+    std::vector<int> merge_removed_;
+    std::thread merger_;
+
+    std::shared_ptr<const Snapshot> LoadSnapshot() const;
+    //метод публикует снимок текущих сегментов и буфера, вызывается под writer_mutex_
+    void Publish();
+    //метод замораживает буфер и открывает новый, вызывается под writer_mutex_
+    void FlushBuffer();
+    //метод выбирает сегменты для слияния, вызывается под writer_mutex_
+    std::vector<Segment> SelectMergeSegments() const;
+    //метод заменяет сегменты списка, вызывается под writer_mutex_
+    void ReplaceSegments(const std::vector<Segment> &removed, std::optional<Segment> added);
+    void RunMerges();
+};
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const Policy &policy, std::string_view raw_query,
+                                                              DocumentPredicate document_predicate, size_t max_count) const {
+    //снимок неизменяем, поэтому IDF посчитан по тем же документам, которые оцениваются
+    const auto snapshot = LoadSnapshot();
+    const std::vector<Segment> &segments = snapshot->segments;
+
+    //общая статистика: количество документов и документная частота плюс-слов по всем сегментам.
+    //стоп-слова у сегментов общие, поэтому запрос проверяется и разбирается любым из них
+    std::vector<std::pair<std::string_view, int>> document_freqs;
+    for (std::string_view word : segments.front().server->ParseQueryPlusWords(raw_query)) {
+        document_freqs.emplace_back(word, 0);
+    }
+    for (const Segment &segment : segments) {
+        for (auto &[word, document_freq] : document_freqs) {
+            document_freq += segment.server->GetDocumentFrequency(word) - segment.removed->GetDocumentFrequency(word);
+        }
+    }
+    const double log_document_count = std::log(static_cast<double>(snapshot->document_count));
+    const auto inverse_document_freq = [&document_freqs, log_document_count](std::string_view word) {
+        const auto it = std::lower_bound(document_freqs.begin(), document_freqs.end(), std::pair(word, 0));
+        if (it == document_freqs.end() || it->first != word || it->second == 0) {
+            return 0.0;
+        }
+        return log_document_count - std::log(static_cast<double>(it->second));
+    };
+
+    std::vector<std::vector<Document>> segment_tops(segments.size());
+    std::vector<size_t> indexes(segments.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+        const Segment &segment = segments[index];
+        //удаленные документы сегмента пропускаются по битовой карте
+        if (segment.removed->GetCount() == 0) {
+            segment_tops[index] = segment.server->FindTopDocuments(policy, raw_query, document_predicate, max_count, inverse_document_freq);
+        } else {
+            segment_tops[index] = segment.server->FindTopDocuments(policy, raw_query, segment.removed->MakeFilter(document_predicate),
+                                                                   max_count, inverse_document_freq);
+        }
+    });
+    TopDocuments top_documents(max_count);
+    for (const auto &segment_top : segment_tops) {
+        for (const Document &document : segment_top) {
+            top_documents.Add(document);
+        }
+    }
+    return top_documents.Release();
+}
+
+template <typename Policy>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const Policy &policy, std::string_view raw_query,
+                                                              DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatusFilter{status}, max_count);
+}
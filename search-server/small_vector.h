@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <type_traits>
+
+//вектор с местом под N элементов внутри объекта: пока элементов не больше N, память не выделяется.
+//при переполнении элементы переезжают в обычный вектор. рассчитан на простые типы (id слов, числа)
+template <typename T, size_t N>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>, "SmallVector holds trivially copyable values only");
+
+public:
+    SmallVector() = default;
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    T *data() {
+        return heap_.empty() ? inline_.data() : heap_.data();
+    }
+
+    const T *data() const {
+        return heap_.empty() ? inline_.data() : heap_.data();
+    }
+
+    T *begin() {
+        return data();
+    }
+
+    T *end() {
+        return data() + size_;
+    }
+
+    const T *begin() const {
+        return data();
+    }
+
+    const T *end() const {
+        return data() + size_;
+    }
+
+    T &operator[](size_t index) {
+        return data()[index];
+    }
+
+    const T &operator[](size_t index) const {
+        return data()[index];
+    }
+
+    void push_back(const T &value) {
+        if (heap_.empty() && size_ < N) {
+            inline_[size_++] = value;
+            return;
+        }
+        if (heap_.empty()) {
+            heap_.assign(inline_.begin(), inline_.begin() + size_);
+        }
+        heap_.push_back(value);
+        ++size_;
+    }
+
+    //метод удаляет элементы [first, last)
+    void erase(T *first, T *last) {
+        std::copy(last, end(), first);
+        resize(size_ - (last - first));
+    }
+
+    void clear() {
+        resize(0);
+    }
+
+private:
+    std::array<T, N> inline_{};
+    //после переполнения здесь лежат все элементы, и heap_.size() == size_
+    std::vector<T> heap_;
+    size_t size_ = 0;
+
+    void resize(size_t size) {
+        if (!heap_.empty()) {
+            heap_.resize(size);
+        }
+        size_ = size;
+        //опустевший вектор снова пользуется внутренним местом
+        if (heap_.empty()) {
+            heap_.shrink_to_fit();
+        }
+    }
+};
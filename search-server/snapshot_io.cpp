@@ -0,0 +1,184 @@
+#include "snapshot_io.h"
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define SNAPSHOT_USE_MMAP 1
+#endif
+
+using namespace std;
+
+namespace {
+    const char SNAPSHOT_SIGNATURE[8] = {'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P'};
+    const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+    const size_t SNAPSHOT_ALIGNMENT = 8;
+}
+
+MappedFile::MappedFile(const string &path) {
+#ifdef SNAPSHOT_USE_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Cannot open snapshot " + path);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        throw runtime_error("Cannot read snapshot " + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw runtime_error("Cannot map snapshot " + path);
+    }
+    data_ = static_cast<const char *>(data);
+    is_mapped_ = true;
+#else
+    ifstream in(path, ios::binary | ios::ate);
+    if (!in) {
+        throw runtime_error("Cannot open snapshot " + path);
+    }
+    size_ = static_cast<size_t>(in.tellg());
+    buffer_.resize((size_ + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    in.seekg(0);
+    if (!in.read(reinterpret_cast<char *>(buffer_.data()), static_cast<streamsize>(size_))) {
+        throw runtime_error("Cannot read snapshot " + path);
+    }
+    data_ = reinterpret_cast<const char *>(buffer_.data());
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef SNAPSHOT_USE_MMAP
+    if (is_mapped_) {
+        munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+}
+
+const char *MappedFile::GetData() const {
+    return data_;
+}
+
+size_t MappedFile::GetSize() const {
+    return size_;
+}
+
+//метод дожидается записи на диск каталога файла, чтобы переименование пережило сбой питания
+void SyncParentDirectory(const string &path) {
+#ifdef SNAPSHOT_USE_MMAP
+    const filesystem::path parent = filesystem::path(path).parent_path();
+    const string directory = parent.empty() ? "."s : parent.string();
+    const int fd = open(directory.c_str(), O_RDONLY);
+    const bool is_synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!is_synced) {
+        throw runtime_error("Cannot sync directory " + directory);
+    }
+#endif
+}
+
+SnapshotWriter::SnapshotWriter(const string &path)
+        : path_(path), temporary_path_(path + ".tmp"), out_(temporary_path_, ios::binary | ios::trunc) {
+    if (!out_) {
+        throw runtime_error("Cannot create snapshot " + path);
+    }
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (!is_finished_) {
+        out_.close();
+        error_code error;
+        filesystem::remove(temporary_path_, error);
+    }
+}
+
+//метод пишет заголовок: сигнатуру, версию формата и метку порядка байт
+void SnapshotWriter::WriteHeader() {
+    WriteBytes(SNAPSHOT_SIGNATURE, sizeof(SNAPSHOT_SIGNATURE));
+    Write(SNAPSHOT_VERSION);
+    Write(SNAPSHOT_BYTE_ORDER);
+}
+
+//метод пишет строку с длиной
+void SnapshotWriter::WriteString(string_view text) {
+    Write(static_cast<uint32_t>(text.size()));
+    WriteBytes(text.data(), text.size());
+}
+
+//метод дописывает файл и дожидается его записи на диск, при ошибке записи бросает runtime_error
+void SnapshotWriter::Finish() {
+    out_.close();
+    if (!out_) {
+        throw runtime_error("Cannot write snapshot " + path_);
+    }
+#ifdef SNAPSHOT_USE_MMAP
+    const int fd = open(temporary_path_.c_str(), O_RDONLY);
+    const bool is_synced = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!is_synced) {
+        throw runtime_error("Cannot write snapshot " + path_);
+    }
+#endif
+    //отображение прежнего снимка держит его файл, поэтому переименование не затрагивает загруженные серверы
+    error_code error;
+    filesystem::rename(temporary_path_, path_, error);
+    if (error) {
+        throw runtime_error("Cannot write snapshot " + path_);
+    }
+    is_finished_ = true;
+    SyncParentDirectory(path_);
+}
+
+void SnapshotWriter::WriteBytes(const void *data, size_t size) {
+    out_.write(static_cast<const char *>(data), static_cast<streamsize>(size));
+    position_ += size;
+}
+
+void SnapshotWriter::Align() {
+    static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+    WriteBytes(zeros, (SNAPSHOT_ALIGNMENT - position_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
+
+SnapshotReader::SnapshotReader(const char *data, size_t size)
+        : data_(data), size_(size) {
+}
+
+//метод проверяет сигнатуру, версию формата и порядок байт
+void SnapshotReader::ReadHeader() {
+    if (memcmp(Take(sizeof(SNAPSHOT_SIGNATURE)), SNAPSHOT_SIGNATURE, sizeof(SNAPSHOT_SIGNATURE)) != 0) {
+        throw runtime_error("File is not a search server snapshot");
+    }
+    if (Read<uint32_t>() != SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported snapshot version");
+    }
+    if (Read<uint32_t>() != SNAPSHOT_BYTE_ORDER) {
+        throw runtime_error("Snapshot byte order does not match");
+    }
+}
+
+//метод читает строку с длиной, представление указывает в память снимка
+string_view SnapshotReader::ReadString() {
+    const uint32_t size = Read<uint32_t>();
+    return {Take(size), size};
+}
+
+const char *SnapshotReader::Take(size_t size) {
+    if (size > size_ - position_) {
+        throw runtime_error("Snapshot is truncated");
+    }
+    const char *result = data_ + position_;
+    position_ += size;
+    return result;
+}
+
+void SnapshotReader::Align() {
+    position_ = min(size_, (position_ + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT);
+}
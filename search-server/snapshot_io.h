@@ -0,0 +1,124 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+
+//версия формата двоичного снимка индекса, увеличивается при любом изменении раскладки
+const uint32_t SNAPSHOT_VERSION = 3;
+
+//файл снимка, отображенный в память только для чтения.
+//там, где mmap недоступен, файл целиком читается в выровненный буфер
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *GetData() const;
+    size_t GetSize() const;
+
+private:
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    bool is_mapped_ = false;
+    std::vector<uint64_t> buffer_;
+};
+
+//метод дожидается записи на диск каталога, в котором лежит файл path, — например, после его переименования.
+//при ошибке бросает runtime_error
+void SyncParentDirectory(const std::string &path);
+
+//запись снимка: значения пишутся в родном порядке байт, массивы выравниваются на 8 байт,
+//чтобы при чтении их можно было использовать прямо из отображенной памяти.
+//снимок пишется во временный файл рядом с path и подменяет path только в Finish, поэтому прежний
+//снимок, в том числе отображенный в память загруженным сервером, не портится
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string &path);
+    //незавершенный временный файл удаляется
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    //метод пишет заголовок: сигнатуру, версию формата и метку порядка байт
+    void WriteHeader();
+
+    template<typename T>
+    void Write(const T &value) {
+        WriteBytes(&value, sizeof(T));
+    }
+
+    //метод пишет массив, выровненный на 8 байт
+    template<typename T>
+    void WriteArray(const T *values, size_t count) {
+        Align();
+        WriteBytes(values, count * sizeof(T));
+    }
+
+    template<typename T>
+    void WriteArray(const std::vector<T> &values) {
+        WriteArray(values.data(), values.size());
+    }
+
+    //метод пишет строку с длиной
+    void WriteString(std::string_view text);
+
+    //метод дописывает временный файл, дожидается его записи на диск и переименовывает его в path.
+    //при ошибке записи бросает runtime_error, прежний снимок остается на месте
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    bool is_finished_ = false;
+    uint64_t position_ = 0;
+
+    void WriteBytes(const void *data, size_t size);
+    void Align();
+};
+
+//чтение снимка из памяти с проверкой границ, поврежденный снимок вызывает runtime_error
+class SnapshotReader {
+public:
+    SnapshotReader(const char *data, size_t size);
+
+    //метод проверяет сигнатуру, версию формата и порядок байт
+    void ReadHeader();
+
+    template<typename T>
+    T Read() {
+        T value;
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    //метод возвращает указатель на выровненный массив прямо в памяти снимка
+    template<typename T>
+    const T *ReadArray(size_t count) {
+        Align();
+        if (count > (size_ - position_) / sizeof(T)) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+        return reinterpret_cast<const T *>(Take(count * sizeof(T)));
+    }
+
+    //метод читает строку с длиной, представление указывает в память снимка
+    std::string_view ReadString();
+
+private:
+    const char *data_;
+    size_t size_;
+    size_t position_ = 0;
+
+    const char *Take(size_t size);
+    void Align();
+};
@@ -0,0 +1,27 @@
+#include "stop_word_filter.h"
+
+using namespace std;
+
+StopWordFilter::StopWordFilter(const set<string, less<>> &stop_words) {
+    if (stop_words.empty()) {
+        return;
+    }
+    const vector<string_view> words(stop_words.begin(), stop_words.end());
+    vector<uint64_t> hashes(words.size());
+    vector<uint32_t> bucket_starts(GetStopWordBucketCount(words.size()) + 1);
+    vector<uint32_t> bucket_words(words.size());
+    vector<uint32_t> slot_words(words.size());
+    displacements_.resize(GetStopWordBucketCount(words.size()));
+    //seed, при котором у каждой корзины нашлось смещение, обычно первый или второй
+    for (uint64_t attempt = 0;; ++attempt) {
+        const uint64_t seed = GetStopWordSeed(attempt);
+        for (size_t i = 0; i < words.size(); ++i) {
+            hashes[i] = HashStopWord(words[i], seed);
+        }
+        if (BuildStopWordHash(hashes, words.size(), bucket_starts, bucket_words, displacements_, slot_words)) {
+            seed_ = seed;
+            break;
+        }
+    }
+    FillSlots(words, slot_words);
+}
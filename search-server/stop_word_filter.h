@@ -0,0 +1,292 @@
+#pragma once
+
+#include <set>
+#include <array>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+//хэш слова для таблицы стоп-слов: слово читается кусками по 8 байт, seed подбирается так,
+//чтобы у стоп-слов не было совпадений в таблице. функция constexpr и годится для таблиц времени компиляции
+constexpr uint64_t HashStopWord(std::string_view word, uint64_t seed) {
+    uint64_t hash = seed ^ (word.size() * 0x9E3779B97F4A7C15ull);
+    for (size_t offset = 0; offset < word.size(); offset += 8) {
+        uint64_t chunk = 0;
+        for (size_t i = 0; i < 8 && offset + i < word.size(); ++i) {
+            chunk |= static_cast<uint64_t>(static_cast<uint8_t>(word[offset + i])) << (8 * i);
+        }
+        hash = (hash ^ chunk) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 31;
+    }
+    return hash * 0x94D049BB133111EBull;
+}
+
+//метод возвращает очередной кандидат в seed совершенного хэширования
+constexpr uint64_t GetStopWordSeed(uint64_t attempt) {
+    uint64_t seed = (attempt + 1) * 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    return seed ^ (seed >> 27);
+}
+
+//метод отображает старшие 32 бита хэша в [0, size) умножением вместо деления
+constexpr size_t ReduceStopWordHash(uint64_t hash, size_t size) {
+    return static_cast<size_t>(((hash >> 32) * static_cast<uint64_t>(size)) >> 32);
+}
+
+//метод возвращает ячейку слова по его хэшу и смещению корзины: отрицательное смещение —
+//номер ячейки, куда слово одиночной корзины положено напрямую, иначе хэш перемешивается со смещением
+constexpr size_t GetStopWordSlot(uint64_t hash, int32_t displacement, size_t slot_count) {
+    if (displacement < 0) {
+        return static_cast<size_t>(-(displacement + 1));
+    }
+    uint64_t mixed = (hash ^ (static_cast<uint64_t>(displacement) * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+    mixed ^= mixed >> 31;
+    return ReduceStopWordHash(mixed * 0x94D049BB133111EBull, slot_count);
+}
+
+//количество корзин хэширования со смещением: в среднем по два слова на корзину
+constexpr size_t GetStopWordBucketCount(size_t word_count) {
+    return (word_count + 1) / 2;
+}
+
+//наибольшее смещение, которое пробуется для корзины, прежде чем взять другой seed
+const int32_t MAX_STOP_WORD_DISPLACEMENT = 1 << 16;
+//номер пустой ячейки при построении таблицы
+const uint32_t NO_STOP_WORD = UINT32_MAX;
+
+//метод строит минимальный совершенный хэш (hash and displace): слова раскладываются по корзинам, корзины
+//размещаются от больших к малым, каждой подбирается смещение, при котором все ее слова попадают
+//в свободные ячейки, а слова одиночных корзин кладутся в оставшиеся ячейки напрямую.
+//ячеек столько же, сколько слов. hashes — хэши слов с выбранным seed; bucket_starts (корзин + 1)
+//и bucket_words (слов) — рабочие массивы; в slots пишутся номера слов, в displacements — смещения корзин.
+//возвращает false, если для какой-то корзины смещение не нашлось: тогда нужен другой seed.
+//работает и во время компиляции, и с векторами во время выполнения
+template <typename Hashes, typename BucketStarts, typename BucketWords, typename Displacements, typename Slots>
+constexpr bool BuildStopWordHash(const Hashes &hashes, size_t word_count, BucketStarts &bucket_starts, BucketWords &bucket_words,
+                                 Displacements &displacements, Slots &slots) {
+    const size_t bucket_count = GetStopWordBucketCount(word_count);
+    //слова группируются по корзинам подсчетом: сначала размеры корзин, потом их концы
+    for (size_t bucket = 0; bucket <= bucket_count; ++bucket) {
+        bucket_starts[bucket] = 0;
+    }
+    for (size_t i = 0; i < word_count; ++i) {
+        ++bucket_starts[ReduceStopWordHash(hashes[i], bucket_count) + 1];
+    }
+    size_t max_bucket_size = 0;
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        const size_t size = bucket_starts[bucket + 1];
+        max_bucket_size = size > max_bucket_size ? size : max_bucket_size;
+        bucket_starts[bucket + 1] += bucket_starts[bucket];
+    }
+    //слова пишутся с конца корзины, после этого bucket_starts[bucket + 1] указывает на начало корзины
+    for (size_t i = 0; i < word_count; ++i) {
+        bucket_words[--bucket_starts[ReduceStopWordHash(hashes[i], bucket_count) + 1]] = static_cast<uint32_t>(i);
+    }
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        bucket_starts[bucket] = bucket_starts[bucket + 1];
+        displacements[bucket] = 0;
+    }
+    bucket_starts[bucket_count] = static_cast<uint32_t>(word_count);
+    for (size_t slot = 0; slot < word_count; ++slot) {
+        slots[slot] = NO_STOP_WORD;
+    }
+
+    //корзины от больших к малым: пока ячейки свободны, большой корзине проще найти смещение
+    for (size_t size = max_bucket_size; size >= 2; --size) {
+        for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+            const size_t begin = bucket_starts[bucket];
+            if (bucket_starts[bucket + 1] - begin != size) {
+                continue;
+            }
+            bool is_placed = false;
+            for (int32_t displacement = 0; displacement < MAX_STOP_WORD_DISPLACEMENT && !is_placed; ++displacement) {
+                size_t placed = 0;
+                while (placed < size) {
+                    const uint32_t word = bucket_words[begin + placed];
+                    const size_t slot = GetStopWordSlot(hashes[word], displacement, word_count);
+                    if (slots[slot] != NO_STOP_WORD) {
+                        break;
+                    }
+                    slots[slot] = word;
+                    ++placed;
+                }
+                if (placed == size) {
+                    displacements[bucket] = displacement;
+                    is_placed = true;
+                } else {
+                    //слова корзины, уже занявшие ячейки при этом смещении, освобождают их
+                    for (size_t i = 0; i < placed; ++i) {
+                        slots[GetStopWordSlot(hashes[bucket_words[begin + i]], displacement, word_count)] = NO_STOP_WORD;
+                    }
+                }
+            }
+            if (!is_placed) {
+                return false;
+            }
+        }
+    }
+    //одиночные корзины занимают оставшиеся ячейки по порядку
+    size_t free_slot = 0;
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        if (bucket_starts[bucket + 1] - bucket_starts[bucket] != 1) {
+            continue;
+        }
+        while (slots[free_slot] != NO_STOP_WORD) {
+            ++free_slot;
+        }
+        slots[free_slot] = bucket_words[bucket_starts[bucket]];
+        displacements[bucket] = -static_cast<int32_t>(free_slot) - 1;
+    }
+    return true;
+}
+
+//таблица стоп-слов, известных при сборке: минимальный совершенный хэш строится компилятором.
+//сервер, созданный из такой таблицы, копирует ее ячейки и смещения и не подбирает seed заново.
+//если seed не найден или слова повторяются, constexpr-вычисление не компилируется
+template <size_t N>
+class StaticStopWordFilter {
+public:
+    constexpr explicit StaticStopWordFilter(const std::array<std::string_view, N> &stop_words)
+            : words_(stop_words) {
+        for (size_t i = 0; i < N; ++i) {
+            if (words_[i].empty()) {
+                throw std::invalid_argument("Stop word is empty");
+            }
+            for (size_t j = 0; j < i; ++j) {
+                if (words_[i] == words_[j]) {
+                    throw std::invalid_argument("Stop word is repeated");
+                }
+            }
+        }
+        std::array<uint64_t, N> hashes{};
+        std::array<uint32_t, N + 1> bucket_starts{};
+        std::array<uint32_t, N> bucket_words{};
+        for (uint64_t attempt = 0; attempt < MAX_SEED_ATTEMPTS; ++attempt) {
+            const uint64_t seed = GetStopWordSeed(attempt);
+            for (size_t i = 0; i < N; ++i) {
+                hashes[i] = HashStopWord(words_[i], seed);
+            }
+            if (BuildStopWordHash(hashes, N, bucket_starts, bucket_words, displacements_, slots_)) {
+                seed_ = seed;
+                return;
+            }
+        }
+        throw std::logic_error("Stop word table has no perfect hash");
+    }
+
+    //метод проверяет, является ли слово стоп-словом
+    constexpr bool Contains(std::string_view word) const {
+        if (N == 0) {
+            return false;
+        }
+        const uint64_t hash = HashStopWord(word, seed_);
+        const size_t slot = GetStopWordSlot(hash, displacements_[ReduceStopWordHash(hash, BUCKET_COUNT)], N);
+        return words_[slots_[slot]] == word;
+    }
+
+    constexpr const std::array<std::string_view, N> &GetWords() const {
+        return words_;
+    }
+
+    constexpr uint64_t GetSeed() const {
+        return seed_;
+    }
+
+    //номера слов по ячейкам таблицы
+    constexpr const std::array<uint32_t, N> &GetSlots() const {
+        return slots_;
+    }
+
+    //смещения корзин
+    constexpr const std::array<int32_t, GetStopWordBucketCount(N)> &GetDisplacements() const {
+        return displacements_;
+    }
+
+private:
+    static constexpr size_t BUCKET_COUNT = GetStopWordBucketCount(N);
+    static constexpr uint64_t MAX_SEED_ATTEMPTS = 1000;
+
+    std::array<std::string_view, N> words_;
+    std::array<uint32_t, N> slots_{};
+    std::array<int32_t, BUCKET_COUNT> displacements_{};
+    uint64_t seed_ = 0;
+};
+
+//метод собирает таблицу стоп-слов времени компиляции: constexpr auto filter = MakeStopWordFilter("and", "in");
+template <typename... Words>
+constexpr StaticStopWordFilter<sizeof...(Words)> MakeStopWordFilter(Words... words) {
+    return StaticStopWordFilter<sizeof...(Words)>({std::string_view(words)...});
+}
+
+//минимальный совершенный хэш стоп-слов: ячеек столько же, сколько слов, и у каждого стоп-слова своя,
+//поэтому проверка слова — одно вычисление хэша, одно смещение корзины и одно сравнение. слова длиной,
+//которой нет среди стоп-слов, отсеиваются по битовой маске длин еще до хэширования.
+//таблица строится при создании сервера за ожидаемое O(стоп-слов) или копируется из StaticStopWordFilter,
+//построенной компилятором
+class StopWordFilter {
+public:
+    StopWordFilter() = default;
+    explicit StopWordFilter(const std::set<std::string, std::less<>> &stop_words);
+    template <size_t N>
+    explicit StopWordFilter(const StaticStopWordFilter<N> &stop_words);
+
+    //метод проверяет, является ли слово стоп-словом
+    bool Contains(std::string_view word) const {
+        if ((length_mask_ & GetLengthBit(word.size())) == 0) {
+            return false;
+        }
+        const uint64_t hash = HashStopWord(word, seed_);
+        const Slot &slot = slots_[GetStopWordSlot(hash, displacements_[ReduceStopWordHash(hash, displacements_.size())], slots_.size())];
+        return slot.hash == hash && slot.length == word.size()
+               && std::string_view(words_.data() + slot.offset, slot.length) == word;
+    }
+
+    //метод возвращает количество ячеек таблицы, оно равно количеству стоп-слов
+    size_t GetSlotCount() const {
+        return slots_.size();
+    }
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    //стоп-слова подряд в порядке ячеек, ячейки ссылаются в эту строку
+    std::string words_;
+    std::vector<Slot> slots_;
+    std::vector<int32_t> displacements_;
+    uint64_t seed_ = 0;
+    uint64_t length_mask_ = 0;
+
+    //метод заполняет ячейки по номерам слов в ячейках
+    template <typename Words, typename SlotWords>
+    void FillSlots(const Words &words, const SlotWords &slot_words);
+
+    //бит длины слова в маске, все длины от 63 делят старший бит
+    static uint64_t GetLengthBit(size_t length) {
+        return uint64_t{1} << (length < 63 ? length : 63);
+    }
+};
+
+template <size_t N>
+StopWordFilter::StopWordFilter(const StaticStopWordFilter<N> &stop_words)
+        : displacements_(stop_words.GetDisplacements().begin(), stop_words.GetDisplacements().end()),
+          seed_(stop_words.GetSeed()) {
+    FillSlots(stop_words.GetWords(), stop_words.GetSlots());
+}
+
+template <typename Words, typename SlotWords>
+void StopWordFilter::FillSlots(const Words &words, const SlotWords &slot_words) {
+    slots_.reserve(slot_words.size());
+    for (const uint32_t index : slot_words) {
+        const std::string_view word = words[index];
+        slots_.push_back({HashStopWord(word, seed_), static_cast<uint32_t>(words_.size()), static_cast<uint32_t>(word.size())});
+        words_ += word;
+        length_mask_ |= GetLengthBit(word.size());
+    }
+}
@@ -1,18 +1,80 @@
 #include "string_processing.h"
+#include "bit_utils.h"
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STRING_PROCESSING_USE_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define STRING_PROCESSING_USE_SSE2 1
+#endif
 
 using namespace std;
 
+namespace {
+    //управляющие символы 0..31 недопустимы в словах
+    inline bool IsControlChar(char c) {
+        return c >= '\0' && c < ' ';
+    }
+
+    //метод добавляет слова, оканчивающиеся пробелами из маски; mask — биты пробелов блока, начинающегося с offset
+    inline void EmitWords(string_view text, size_t offset, uint32_t mask, size_t &word_begin, vector<string_view> &words) {
+        while (mask != 0) {
+            const size_t space = offset + CountTrailingZeros(mask);
+            words.push_back(text.substr(word_begin, space - word_begin));
+            word_begin = space + 1;
+            mask &= mask - 1;
+        }
+    }
+}
+
 //метод разделяет слова по пробелам
 vector <string_view> SplitIntoWords(string_view text) {
     vector <string_view> result;
-    while (true) {
-        size_t space = text.find(' ');
-        result.push_back(text.substr(0, space));
-        if (space == text.npos) {
-            break;
-        } else {
-            text.remove_prefix(space + 1);
+    SplitIntoWords(text, result);
+    return result;
+}
+
+//метод разделяет слова по пробелам за один проход: блоками по 16 (SSE2) или 32 (AVX2) байта
+//сравнением ищутся сразу пробелы и управляющие символы, слова пишутся в буфер words
+bool SplitIntoWords(string_view text, vector<string_view> &words) {
+    words.clear();
+    const char *data = text.data();
+    size_t word_begin = 0;
+    size_t i = 0;
+    bool is_valid = true;
+#if defined(STRING_PROCESSING_USE_AVX2)
+    const __m256i spaces = _mm256_set1_epi8(' ');
+    const __m256i minus_one = _mm256_set1_epi8(-1);
+    __m256i invalid = _mm256_setzero_si256();
+    for (; i + 32 <= text.size(); i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        //знаковое сравнение: байты от 128 и выше отрицательны и управляющими не считаются
+        invalid = _mm256_or_si256(invalid, _mm256_and_si256(_mm256_cmpgt_epi8(spaces, bytes), _mm256_cmpgt_epi8(bytes, minus_one)));
+        EmitWords(text, i, static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, spaces))), word_begin, words);
+    }
+    is_valid = _mm256_movemask_epi8(invalid) == 0;
+#elif defined(STRING_PROCESSING_USE_SSE2)
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i minus_one = _mm_set1_epi8(-1);
+    __m128i invalid = _mm_setzero_si128();
+    for (; i + 16 <= text.size(); i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        //знаковое сравнение: байты от 128 и выше отрицательны и управляющими не считаются
+        invalid = _mm_or_si128(invalid, _mm_and_si128(_mm_cmplt_epi8(bytes, spaces), _mm_cmpgt_epi8(bytes, minus_one)));
+        EmitWords(text, i, static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, spaces))), word_begin, words);
+    }
+    is_valid = _mm_movemask_epi8(invalid) == 0;
+#endif
+    for (; i < text.size(); ++i) {
+        if (data[i] == ' ') {
+            words.push_back(text.substr(word_begin, i - word_begin));
+            word_begin = i + 1;
+        } else if (IsControlChar(data[i])) {
+            is_valid = false;
         }
     }
-    return result;
-}
\ No newline at end of file
+    words.push_back(text.substr(word_begin));
+    return is_valid;
+}
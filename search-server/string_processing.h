@@ -4,9 +4,13 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <string_view>
 
 //метод разделяет слова по пробелам
 std::vector <std::string_view> SplitIntoWords(std::string_view text);
+//метод разделяет слова по пробелам в буфер words, который переиспользуется между вызовами.
+//за тот же проход текст проверяется на управляющие символы: возвращает false, если они есть
+bool SplitIntoWords(std::string_view text, std::vector<std::string_view> &words);
 
 //метод проверяет запрос на пустоту
 template<typename StringContainer>
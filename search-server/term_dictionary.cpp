@@ -0,0 +1,64 @@
+#include "term_dictionary.h"
+
+using namespace std;
+
+//копия строит ключи поиска по своим строкам, а не по строкам исходного словаря
+TermDictionary::TermDictionary(const TermDictionary &other)
+    : words_(other.words_) {
+    ids_.reserve(words_.size());
+    for (size_t term = 0; term < words_.size(); ++term) {
+        ids_.emplace(words_[term], static_cast<TermId>(term));
+    }
+}
+
+TermDictionary &TermDictionary::operator=(const TermDictionary &other) {
+    if (this != &other) {
+        TermDictionary copy(other);
+        *this = move(copy);
+    }
+    return *this;
+}
+
+//метод возвращает id слова, добавляя слово в словарь при необходимости
+TermId TermDictionary::Intern(string_view word) {
+    const auto it = ids_.find(word);
+    if (it != ids_.end()) {
+        return it->second;
+    }
+    const TermId term = static_cast<TermId>(words_.size());
+    words_.emplace_back(word);
+    ids_.emplace(words_.back(), term);
+    return term;
+}
+
+//метод возвращает id слова или NO_TERM, если слова нет в словаре
+TermId TermDictionary::Find(string_view word) const {
+    const auto it = ids_.find(word);
+    return it == ids_.end() ? NO_TERM : it->second;
+}
+
+//метод возвращает слово по id, представление живет вместе со словарем
+string_view TermDictionary::GetWord(TermId term) const {
+    return words_[term];
+}
+
+//метод возвращает количество слов в словаре
+size_t TermDictionary::GetSize() const {
+    return words_.size();
+}
+
+//метод оставляет слова с new_terms[term] != NO_TERM под новыми id, порядок id сохраняется
+void TermDictionary::Compact(const vector<TermId> &new_terms) {
+    deque<string> words;
+    for (size_t term = 0; term < words_.size(); ++term) {
+        if (new_terms[term] != NO_TERM) {
+            words.push_back(move(words_[term]));
+        }
+    }
+    words_ = move(words);
+    ids_.clear();
+    ids_.reserve(words_.size());
+    for (size_t term = 0; term < words_.size(); ++term) {
+        ids_.emplace(words_[term], static_cast<TermId>(term));
+    }
+}
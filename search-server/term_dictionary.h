@@ -0,0 +1,49 @@
+#pragma once
+
+#include <deque>
+#include <limits>
+#include <string>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//плотный числовой идентификатор слова
+using TermId = uint32_t;
+
+//словарь слов индекса: каждое различное слово хранится один раз
+//и получает плотный id, по которому адресуются все внутренние структуры
+class TermDictionary {
+public:
+    //id, возвращаемый для слова, отсутствующего в словаре
+    static constexpr TermId NO_TERM = std::numeric_limits<TermId>::max();
+
+    TermDictionary() = default;
+    //копия строит ключи поиска по своим строкам, а не по строкам исходного словаря
+    TermDictionary(const TermDictionary &other);
+    TermDictionary &operator=(const TermDictionary &other);
+    //перемещение deque не перемещает строки, ключи остаются валидными
+    TermDictionary(TermDictionary &&other) noexcept = default;
+    TermDictionary &operator=(TermDictionary &&other) noexcept = default;
+
+    //метод возвращает id слова, добавляя слово в словарь при необходимости
+    TermId Intern(std::string_view word);
+
+    //метод возвращает id слова или NO_TERM, если слова нет в словаре
+    TermId Find(std::string_view word) const;
+
+    //метод возвращает слово по id, представление живет вместе со словарем
+    std::string_view GetWord(TermId term) const;
+
+    //метод возвращает количество слов в словаре
+    size_t GetSize() const;
+
+    //метод оставляет слова с new_terms[term] != NO_TERM под новыми id, порядок id сохраняется.
+    //представления слов, полученные до вызова, становятся недействительными
+    void Compact(const std::vector<TermId> &new_terms);
+
+private:
+    //deque не перемещает строки при росте, поэтому string_view на них остаются валидными
+    std::deque<std::string> words_;
+    std::unordered_map<std::string_view, TermId> ids_;
+};
@@ -0,0 +1,1629 @@
+#include "test_example_functions.h"
+#include "search_server.h"
+#include "durable_search_server.h"
+#include "write_ahead_log.h"
+#include "segmented_search_server.h"
+#include "versioned_search_server.h"
+#include "stop_word_filter.h"
+#include "process_queries.h"
+#include "forward_index.h"
+#include "frozen_index.h"
+#include "term_dictionary.h"
+#include "thread_pool.h"
+#include "top_documents.h"
+#include "score_accumulator.h"
+#include "small_vector.h"
+#include "snapshot_io.h"
+#include "string_processing.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+template <typename T, typename U>
+void AssertEqualImpl(const T &t, const U &u, const string &t_str, const string &u_str, const string &file,
+                     const string &func, unsigned line, const string &hint) {
+    if (t != u) {
+        cerr << boolalpha;
+        cerr << file << "("s << line << "): "s << func << ": "s;
+        cerr << "ASSERT_EQUAL("s << t_str << ", "s << u_str << ") failed: "s;
+        cerr << t << " != "s << u << "."s;
+        if (!hint.empty()) {
+            cerr << " Hint: "s << hint;
+        }
+        cerr << endl;
+        abort();
+    }
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+void AssertImpl(bool value, const string &expr_str, const string &file, const string &func, unsigned line,
+                const string &hint) {
+    if (!value) {
+        cerr << file << "("s << line << "): "s << func << ": "s;
+        cerr << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty()) {
+            cerr << " Hint: "s << hint;
+        }
+        cerr << endl;
+        abort();
+    }
+}
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, ""s)
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+#define ASSERT_THROWS_INVALID_ARGUMENT(expr)                                  \
+    do {                                                                      \
+        bool is_thrown = false;                                               \
+        try {                                                                 \
+            expr;                                                             \
+        } catch (const invalid_argument &) {                                  \
+            is_thrown = true;                                                 \
+        }                                                                     \
+        ASSERT_HINT(is_thrown, #expr " must throw invalid_argument"s);        \
+    } while (false)
+
+template <typename TestFunc>
+void RunTestImpl(const TestFunc &func, const string &test_name) {
+    func();
+    cerr << test_name << " OK"s << endl;
+}
+
+#define RUN_TEST(func) RunTestImpl(func, #func)
+
+namespace {
+    const vector<string> TEST_DOCUMENTS = {
+            "white cat and fashionable collar"s,
+            "fluffy cat fluffy tail"s,
+            "groomed dog expressive eyes"s,
+            "groomed starling eugene"s,
+            "fluffy dog and groomed collar"s,
+            "cat in the city"s,
+    };
+
+    //метод заполняет сервер тестовыми документами с id от first_id, документы с нечетным номером забанены
+    void AddTestDocuments(SearchServer &search_server, int first_id = 0) {
+        for (size_t i = 0; i < TEST_DOCUMENTS.size(); ++i) {
+            const DocumentStatus status = i % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+            search_server.AddDocument(first_id + static_cast<int>(i), TEST_DOCUMENTS[i], status, {static_cast<int>(i)});
+        }
+    }
+
+    //метод сравнивает выдачу: id и рейтинги совпадают, релевантности — с точностью до округления
+    void AssertSameDocuments(const vector<Document> &lhs, const vector<Document> &rhs, const string &hint) {
+        ASSERT_EQUAL_HINT(lhs.size(), rhs.size(), hint);
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL_HINT(lhs[i].id, rhs[i].id, hint);
+            ASSERT_EQUAL_HINT(lhs[i].rating, rhs[i].rating, hint);
+            ASSERT_HINT(abs(lhs[i].relevance - rhs[i].relevance) < 1e-9, hint);
+        }
+    }
+
+    const vector<string> TEST_QUERIES = {
+            "fluffy groomed cat"s,
+            "cat -collar"s,
+            "groomed dog and eyes"s,
+            "city starling -white"s,
+    };
+
+    //метод возвращает путь временного файла теста
+    string MakeTemporaryPath(const string &name) {
+        return (filesystem::temp_directory_path() / ("search_server_test_"s + name)).string();
+    }
+
+    //метод сравнивает выдачу двух серверов по тестовым запросам для обоих статусов
+    void AssertSameResults(const SearchServer &lhs, const SearchServer &rhs, const string &hint) {
+        for (const string &query : TEST_QUERIES) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                AssertSameDocuments(lhs.FindTopDocuments(query, status), rhs.FindTopDocuments(query, status), hint + ": "s + query);
+            }
+        }
+    }
+
+    //метод заполняет сервер документами из слов небольшого словаря: у частых слов длинные списки постингов,
+    //у редких — короткие, рейтинг равен id, поэтому порядок документов с равной релевантностью однозначен.
+    //id документов идут подряд от first_id
+    void AddGeneratedDocuments(SearchServer &search_server, int document_count, int first_id = 0) {
+        const vector<string> words = {"cat"s, "dog"s, "fluffy"s, "groomed"s, "collar"s, "tail"s,
+                                      "eyes"s, "city"s, "starling"s, "white"s, "and"s, "the"s};
+        uint32_t seed = 1;
+        for (int document_id = first_id; document_id < first_id + document_count; ++document_id) {
+            string text;
+            const int word_count = 2 + document_id % 7;
+            for (int i = 0; i < word_count; ++i) {
+                seed = seed * 1103515245u + 12345u;
+                //квадрат смещает выбор к началу словаря
+                const size_t index = (seed >> 16) % words.size();
+                text += words[index * index / words.size()] + " "s;
+            }
+            const DocumentStatus status = document_id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            search_server.AddDocument(document_id, text, status, {document_id});
+        }
+    }
+
+    //метод возвращает постинги слота замороженного индекса парами «номер документа — число вхождений»
+    vector<pair<int, uint32_t>> GetFrozenPostings(const FrozenIndex &index, size_t slot) {
+        vector<pair<int, uint32_t>> postings;
+        index.ForEach(slot, 0, numeric_limits<int>::max(), [&postings](int ordinal, uint32_t count) {
+            postings.emplace_back(ordinal, count);
+        });
+        return postings;
+    }
+
+    //метод проверяет, что слоты замороженного индекса хранят ровно списки lists
+    void AssertSameFrozenPostings(const FrozenIndex &index, const vector<vector<FrozenPosting>> &lists, const string &hint) {
+        ASSERT_EQUAL_HINT(index.GetSlotCount(), lists.size(), hint);
+        for (size_t slot = 0; slot < lists.size(); ++slot) {
+            const vector<pair<int, uint32_t>> postings = GetFrozenPostings(index, slot);
+            ASSERT_EQUAL_HINT(postings.size(), lists[slot].size(), hint);
+            ASSERT_EQUAL_HINT(index.GetPostingCount(slot), lists[slot].size(), hint);
+            for (size_t i = 0; i < postings.size(); ++i) {
+                ASSERT_EQUAL_HINT(postings[i].first, lists[slot][i].ordinal, hint);
+                ASSERT_EQUAL_HINT(postings[i].second, lists[slot][i].count, hint);
+                ASSERT_HINT(index.Contains(slot, lists[slot][i].ordinal), hint);
+            }
+        }
+    }
+
+    //метод пишет замороженный индекс в файл снимка и подключает его обратно из памяти
+    FrozenIndex SaveAndAttach(const FrozenIndex &index, int ordinal_count, const string &path) {
+        {
+            SnapshotWriter writer(path);
+            index.Save(writer);
+            writer.Finish();
+        }
+        ifstream in(path, ios::binary);
+        const auto data = make_shared<const string>((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        SnapshotReader reader(data->data(), data->size());
+        FrozenIndex attached;
+        attached.Attach(reader, ordinal_count, data);
+        filesystem::remove(path);
+        return attached;
+    }
+}
+
+//уплотнение нумерует живые документы подряд и не меняет выдачу
+void TestCompactKeepsResults() {
+    SearchServer search_server("and in the"s);
+    AddTestDocuments(search_server);
+    search_server.RemoveDocument(1);
+    search_server.RemoveDocuments({3, 4});
+    search_server.Compact();
+
+    SearchServer expected("and in the"s);
+    for (const int document_id : {0, 2, 5}) {
+        expected.AddDocument(document_id, TEST_DOCUMENTS[document_id],
+                             document_id % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, {document_id});
+    }
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    AssertSameResults(search_server, expected, "compacted mutable index"s);
+
+    //замороженный индекс уплотняется на месте, новые документы получают номера после живых
+    search_server.Freeze();
+    search_server.RemoveDocument(2);
+    expected.RemoveDocument(2);
+    search_server.Freeze();
+    search_server.Compact();
+    ASSERT(search_server.IsFrozen());
+    AssertSameResults(search_server, expected, "compacted frozen index"s);
+    search_server.AddDocument(10, "fluffy starling"s, DocumentStatus::ACTUAL, {7});
+    expected.AddDocument(10, "fluffy starling"s, DocumentStatus::ACTUAL, {7});
+    AssertSameResults(search_server, expected, "document added after compaction"s);
+}
+
+//помеченные документы сразу пропадают из выдачи, а вычищаются только по порогу или явным Compact
+void TestTombstones() {
+    SearchServer search_server("and in the"s);
+    AddTestDocuments(search_server);
+    search_server.EnableTombstones();
+    search_server.RemoveDocument(0);
+    search_server.RemoveDocuments({2, 4, 100});
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    ASSERT_EQUAL_HINT(search_server.GetDeadDocumentCount(), 3, "half of the documents do not exceed the default threshold"s);
+    ASSERT(search_server.FindTopDocuments("fluffy groomed"s).empty());
+    ASSERT_EQUAL(get<0>(search_server.MatchDocument("cat"s, 1)).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("groomed"s, DocumentStatus::BANNED).size(), 1u);
+    search_server.Compact();
+    ASSERT_EQUAL(search_server.GetDeadDocumentCount(), 0);
+    ASSERT_EQUAL(search_server.FindTopDocuments("fluffy groomed"s, DocumentStatus::BANNED).size(), 2u);
+
+    SearchServer sparse_server("and in the"s);
+    AddTestDocuments(sparse_server);
+    sparse_server.EnableTombstones(0.25);
+    sparse_server.RemoveDocument(0);
+    ASSERT_EQUAL(sparse_server.GetDeadDocumentCount(), 1);
+    sparse_server.RemoveDocument(1);
+    ASSERT_EQUAL_HINT(sparse_server.GetDeadDocumentCount(), 0, "threshold 0.25 is exceeded"s);
+    ASSERT_EQUAL(sparse_server.GetDocumentCount(), 4);
+
+    //немедленное удаление тоже уплотняет индекс по порогу по умолчанию, а скомпилированный запрос
+    //разбирается заново после перенумерации слов
+    SearchServer immediate_server("and in the"s);
+    AddTestDocuments(immediate_server);
+    const SearchServer::CompiledQuery query = immediate_server.CompileQuery("starling eugene cat -dog"s);
+    immediate_server.RemoveDocuments({0, 1});
+    immediate_server.RemoveDocument(3);
+    immediate_server.RemoveDocument(4);
+    SearchServer expected("and in the"s);
+    expected.AddDocument(2, TEST_DOCUMENTS[2], DocumentStatus::ACTUAL, {2});
+    expected.AddDocument(5, TEST_DOCUMENTS[5], DocumentStatus::BANNED, {5});
+    AssertSameResults(immediate_server, expected, "compacted by immediate removal"s);
+    ASSERT_EQUAL(immediate_server.FindTopDocuments(query, DocumentStatus::BANNED).size(), 1u);
+    immediate_server.AddDocument(6, "starling cat"s, DocumentStatus::ACTUAL, {6});
+    expected.AddDocument(6, "starling cat"s, DocumentStatus::ACTUAL, {6});
+    AssertSameDocuments(immediate_server.FindTopDocuments(query), expected.FindTopDocuments("starling eugene cat -dog"s), "compiled query"s);
+    ASSERT_EQUAL(get<0>(immediate_server.MatchDocument("starling collar"s, 6)).size(), 1u);
+}
+
+//снимок загружается с той же выдачей, включая документ только из стоп-слов и помеченные документы
+void TestSnapshotRoundTrip() {
+    const string path = MakeTemporaryPath("snapshot"s);
+    SearchServer search_server("and in the"s);
+    AddTestDocuments(search_server);
+    search_server.AddDocument(20, "and in the"s, DocumentStatus::IRRELEVANT, {5});
+    search_server.EnableTombstones();
+    search_server.RemoveDocument(3);
+    search_server.Save(path);
+
+    SearchServer loaded = SearchServer::Load(path);
+    ASSERT(loaded.IsFrozen());
+    ASSERT_EQUAL(loaded.GetDocumentCount(), search_server.GetDocumentCount());
+    ASSERT(!loaded.HasDocument(3));
+    ASSERT(loaded.HasDocument(20));
+    ASSERT(get<0>(loaded.MatchDocument("and cat"s, 20)).empty());
+    ASSERT(get<1>(loaded.MatchDocument("and cat"s, 20)) == DocumentStatus::IRRELEVANT);
+    AssertSameResults(loaded, search_server, "loaded snapshot"s);
+
+    //сохранение поверх отображенного снимка не портит загруженный из него сервер
+    search_server.AddDocument(30, "fluffy fluffy starling"s, DocumentStatus::ACTUAL, {1});
+    search_server.Save(path);
+    ASSERT(!loaded.HasDocument(30));
+    search_server.RemoveDocument(30);
+    AssertSameResults(loaded, search_server, "server loaded from overwritten snapshot"s);
+    search_server.AddDocument(30, "fluffy fluffy starling"s, DocumentStatus::ACTUAL, {1});
+    AssertSameResults(SearchServer::Load(path), search_server, "overwritten snapshot"s);
+    ASSERT(!filesystem::exists(path + ".tmp"s));
+    filesystem::remove(path);
+}
+
+//частоты слов загруженного снимка строятся по прямому индексу из отображения, неупорядоченные слова документа отвергаются
+void TestSnapshotForwardIndex() {
+    const string path = MakeTemporaryPath("forward_index"s);
+    SearchServer search_server("and in the"s);
+    AddTestDocuments(search_server);
+    search_server.Save(path);
+    SearchServer loaded = SearchServer::Load(path);
+    loaded.AddDocument(30, "fluffy fluffy kitten"s, DocumentStatus::ACTUAL, {1});
+    search_server.AddDocument(30, "fluffy fluffy kitten"s, DocumentStatus::ACTUAL, {1});
+    for (const int document_id : search_server) {
+        ASSERT_HINT(loaded.GetWordFrequencies(document_id) == search_server.GetWordFrequencies(document_id), to_string(document_id));
+        const auto [words, status] = loaded.MatchDocument("fluffy kitten collar"s, document_id);
+        ASSERT_HINT(words == get<0>(search_server.MatchDocument("fluffy kitten collar"s, document_id)), to_string(document_id));
+    }
+    loaded.RemoveDocument(1);
+    ASSERT(loaded.GetWordFrequencies(1).empty());
+    filesystem::remove(path);
+
+    //у документа слова 2 и 1 идут не по возрастанию
+    {
+        SnapshotWriter writer(path);
+        writer.Write(uint64_t{2});
+        writer.WriteArray(vector<uint64_t>{0, 2});
+        writer.WriteArray(vector<TermId>{2, 1});
+        writer.WriteArray(vector<double>{0.5, 0.5});
+        writer.Finish();
+    }
+    ifstream in(path, ios::binary);
+    const string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    SnapshotReader reader(data.data(), data.size());
+    bool is_thrown = false;
+    try {
+        ForwardIndex().Attach(reader, 1, 3, nullptr);
+    } catch (const runtime_error &) {
+        is_thrown = true;
+    }
+    ASSERT_HINT(is_thrown, "unsorted document terms must be rejected"s);
+    filesystem::remove(path);
+}
+
+//журнал доигрывается поверх снимка, оборванный хвост отрезается, а снимок после Checkpoint загружается
+void TestDurableServerRecovery() {
+    const string snapshot_path = MakeTemporaryPath("durable_snapshot"s);
+    const string log_path = MakeTemporaryPath("durable_log"s);
+    filesystem::remove(snapshot_path);
+    filesystem::remove(log_path);
+
+    SearchServer expected("and in the"s);
+    {
+        DurableSearchServer durable_server("and in the"s, snapshot_path, log_path);
+        AddTestDocuments(expected);
+        for (size_t i = 0; i < TEST_DOCUMENTS.size(); ++i) {
+            durable_server.AddDocument(static_cast<int>(i), TEST_DOCUMENTS[i],
+                                       i % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED, {static_cast<int>(i)});
+        }
+        durable_server.AddDocument(20, "and in the"s, DocumentStatus::ACTUAL, {});
+        expected.AddDocument(20, "and in the"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(!filesystem::exists(snapshot_path), "no checkpoint yet"s);
+    }
+
+    //оборванная при сбое запись в конце журнала отбрасывается
+    {
+        ofstream log(log_path, ios::binary | ios::app);
+        log << "\x20\x00\x00\x00torn"s;
+    }
+    {
+        DurableSearchServer durable_server("and in the"s, snapshot_path, log_path);
+        AssertSameResults(durable_server.GetServer(), expected, "replayed log"s);
+        durable_server.RemoveDocument(1);
+        expected.RemoveDocument(1);
+    }
+    {
+        //запись, дописанная после отрезанного хвоста, доигрывается
+        DurableSearchServer durable_server("and in the"s, snapshot_path, log_path);
+        ASSERT(!durable_server.GetServer().HasDocument(1));
+        ASSERT_THROWS_INVALID_ARGUMENT(durable_server.AddDocument(2, "duplicate"s, DocumentStatus::ACTUAL, {}));
+        ASSERT_THROWS_INVALID_ARGUMENT(durable_server.AddDocument(40, "bad\x01word"s, DocumentStatus::ACTUAL, {}));
+        //документ только из стоп-слов не мешает снимку загрузиться
+        durable_server.Checkpoint();
+        durable_server.AddDocument(30, "fluffy starling"s, DocumentStatus::ACTUAL, {3});
+        expected.AddDocument(30, "fluffy starling"s, DocumentStatus::ACTUAL, {3});
+    }
+    {
+        //параллельные изменения применяются к индексу в порядке журнала, а снимок, снятый во время них,
+        //не теряет записей, уже попавших в журнал
+        DurableSearchServer durable_server("and in the"s, snapshot_path, log_path);
+        vector<thread> writers;
+        atomic<int> duplicate_successes = 0;
+        for (int writer = 0; writer < 4; ++writer) {
+            writers.emplace_back([&durable_server, &duplicate_successes, writer] {
+                try {
+                    durable_server.AddDocument(500, "collar"s, DocumentStatus::ACTUAL, {});
+                    ++duplicate_successes;
+                } catch (const invalid_argument &) {
+                }
+                for (int i = 0; i < 25; ++i) {
+                    const int document_id = 100 + writer * 25 + i;
+                    durable_server.AddDocument(document_id, "groomed starling"s, DocumentStatus::ACTUAL, {document_id});
+                    if (i % 5 == 0) {
+                        durable_server.RemoveDocument(document_id);
+                    }
+                }
+            });
+        }
+        durable_server.Checkpoint();
+        for (thread &writer : writers) {
+            writer.join();
+        }
+        ASSERT_EQUAL(duplicate_successes.load(), 1);
+        expected.AddDocument(500, "collar"s, DocumentStatus::ACTUAL, {});
+        for (int document_id = 100; document_id < 200; ++document_id) {
+            if ((document_id - 100) % 25 % 5 != 0) {
+                expected.AddDocument(document_id, "groomed starling"s, DocumentStatus::ACTUAL, {document_id});
+            }
+        }
+        ASSERT_EQUAL(durable_server.GetServer().GetDocumentCount(), expected.GetDocumentCount());
+        durable_server.Checkpoint();
+        ASSERT_HINT(!filesystem::exists(snapshot_path + ".tmp"s), "snapshot is replaced in place"s);
+        ASSERT_HINT(!filesystem::exists(snapshot_path + ".tmp.tmp"s), "snapshot is replaced in place"s);
+    }
+    {
+        DurableSearchServer durable_server("and in the"s, snapshot_path, log_path);
+        ASSERT(durable_server.GetServer().HasDocument(20));
+        ASSERT(!durable_server.GetServer().HasDocument(40));
+        AssertSameResults(durable_server.GetServer(), expected, "snapshot and log tail"s);
+    }
+    filesystem::remove(snapshot_path);
+    filesystem::remove(log_path);
+}
+
+//запись с верной контрольной суммой, но неизвестным статусом, не доигрывается
+void TestWriteAheadLogRejectsBadStatus() {
+    const string log_path = MakeTemporaryPath("bad_status_log"s);
+    filesystem::remove(log_path);
+    {
+        WriteAheadLog log(log_path);
+        log.WaitDurable(log.AppendAdd(1, "cat"s, static_cast<DocumentStatus>(9), {}));
+    }
+    WriteAheadLog log(log_path);
+    SearchServer search_server("and"s);
+    bool is_rejected = false;
+    try {
+        log.Replay(search_server);
+    } catch (const runtime_error &) {
+        is_rejected = true;
+    }
+    ASSERT(is_rejected);
+    filesystem::remove(log_path);
+}
+
+//сегменты ищутся с общим IDF всего индекса, и выдача совпадает с одним сервером до и после слияний
+void TestSegmentedServerMatchesSingleServer() {
+    SegmentedSearchServer segmented_server("and in the"s, 2);
+    SearchServer expected("and in the"s);
+    //рейтинг равен id, поэтому порядок документов с равной релевантностью однозначен
+    for (int round = 0; round < 4; ++round) {
+        for (size_t i = 0; i < TEST_DOCUMENTS.size(); ++i) {
+            const int document_id = round * 10 + static_cast<int>(i);
+            const DocumentStatus status = i % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+            segmented_server.AddDocument(document_id, TEST_DOCUMENTS[i], status, {document_id});
+            expected.AddDocument(document_id, TEST_DOCUMENTS[i], status, {document_id});
+        }
+    }
+    segmented_server.RemoveDocument(12);
+    expected.RemoveDocument(12);
+    ASSERT_THROWS_INVALID_ARGUMENT(segmented_server.AddDocument(0, "cat"s, DocumentStatus::ACTUAL, {}));
+
+    //поиск по опубликованному снимку идет одновременно с записью и слияниями, не дожидаясь их
+    atomic<bool> is_writing = true;
+    thread reader([&segmented_server, &is_writing] {
+        while (is_writing) {
+            for (const Document &document : segmented_server.FindTopDocuments(execution::seq, "fluffy cat"s, DocumentStatus::ACTUAL, 1000)) {
+                ASSERT(document.relevance > 0.0);
+            }
+        }
+    });
+    for (int document_id = 100; document_id < 140; ++document_id) {
+        segmented_server.AddDocument(document_id, "fluffy cat"s, DocumentStatus::ACTUAL, {document_id});
+    }
+    for (int document_id = 100; document_id < 140; ++document_id) {
+        segmented_server.RemoveDocument(document_id);
+    }
+    is_writing = false;
+    reader.join();
+
+    const auto assert_same_results = [&](const string &hint) {
+        ASSERT_EQUAL_HINT(segmented_server.GetDocumentCount(), expected.GetDocumentCount(), hint);
+        //стоп-слова и слова вне индекса не влияют на IDF остальных слов
+        for (const string &query : {"fluffy groomed cat"s, "cat -collar and"s, "the groomed dog unknown"s, "city -white"s}) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                AssertSameDocuments(segmented_server.FindTopDocuments(execution::seq, query, status),
+                                    expected.FindTopDocuments(query, status), hint + ": "s + query);
+                AssertSameDocuments(segmented_server.FindTopDocuments(execution::par, query, status),
+                                    expected.FindTopDocuments(query, status), hint + ": "s + query);
+            }
+        }
+    };
+    assert_same_results("segments before merge"s);
+    segmented_server.Flush();
+    segmented_server.WaitForMerges();
+    ASSERT_HINT(segmented_server.GetSegmentCount() < 13, "full tiers are merged"s);
+    assert_same_results("merged segments"s);
+    ASSERT_THROWS_INVALID_ARGUMENT(segmented_server.FindTopDocuments("cat --collar"s));
+}
+
+//снимок не видит изменений, сделанных после него, а выдача версии совпадает с выдачей одного SearchServer
+void TestVersionedServerIsolatesViews() {
+    //малая емкость дельты, чтобы версии собирались в новую основу по ходу теста
+    VersionedSearchServer versioned_server("and in the"s, 8);
+    SearchServer expected("and in the"s);
+    for (int round = 0; round < 3; ++round) {
+        for (size_t i = 0; i < TEST_DOCUMENTS.size(); ++i) {
+            const int document_id = round * 10 + static_cast<int>(i);
+            const DocumentStatus status = i % 2 == 0 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+            versioned_server.AddDocument(document_id, TEST_DOCUMENTS[i], status, {document_id});
+            expected.AddDocument(document_id, TEST_DOCUMENTS[i], status, {document_id});
+        }
+    }
+    ASSERT_THROWS_INVALID_ARGUMENT(versioned_server.AddDocument(0, "cat"s, DocumentStatus::ACTUAL, {}));
+
+    const auto assert_same_results = [&expected](const VersionedSearchServer::View &view, const string &hint) {
+        ASSERT_EQUAL_HINT(view.GetDocumentCount(), expected.GetDocumentCount(), hint);
+        const auto is_even = [](int document_id, DocumentStatus, int) {
+            return document_id % 2 == 0;
+        };
+        for (const string &query : {"fluffy groomed cat"s, "cat -collar and"s, "the groomed dog unknown"s, "city -white"s}) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                AssertSameDocuments(view.FindTopDocuments(execution::seq, query, status),
+                                    expected.FindTopDocuments(query, status), hint + ": "s + query);
+                AssertSameDocuments(view.FindTopDocuments(execution::par, query, status),
+                                    expected.FindTopDocuments(query, status), hint + ": "s + query);
+            }
+            AssertSameDocuments(view.FindTopDocuments(query, is_even), expected.FindTopDocuments(query, is_even), hint + ": "s + query);
+        }
+    };
+    const VersionedSearchServer::View old_view = versioned_server.GetView();
+    const vector<Document> old_top = old_view.FindTopDocuments("fluffy groomed cat"s);
+    assert_same_results(old_view, "initial version"s);
+
+    //удаление из основы и повторное добавление того же id в дельту
+    versioned_server.RemoveDocuments({3, 12});
+    expected.RemoveDocument(3);
+    expected.RemoveDocument(12);
+    versioned_server.AddDocument(12, "fluffy cat in the city"s, DocumentStatus::ACTUAL, {12});
+    expected.AddDocument(12, "fluffy cat in the city"s, DocumentStatus::ACTUAL, {12});
+    assert_same_results(versioned_server.GetView(), "base with delta"s);
+    bool is_removed_matched = true;
+    try {
+        versioned_server.GetView().MatchDocument("cat"s, 3);
+    } catch (const out_of_range &) {
+        is_removed_matched = false;
+    }
+    ASSERT_HINT(!is_removed_matched, "removed document is not matched"s);
+
+    //снимок, взятый до изменений, их не видит
+    ASSERT_EQUAL(old_view.GetDocumentCount(), 18);
+    ASSERT(old_view.HasDocument(3));
+    AssertSameDocuments(old_view.FindTopDocuments("fluffy groomed cat"s), old_top, "old view is unchanged"s);
+
+    //поток, держащий снимок, сам изменяет сервер и не ждет собственного снимка
+    versioned_server.Update([](SearchServer &search_server) {
+        search_server.RemoveDocument(0);
+    });
+    expected.RemoveDocument(0);
+    assert_same_results(versioned_server.GetView(), "after update"s);
+
+    //изменение, бросившее исключение, не публикует версию
+    const uint64_t version = versioned_server.GetView().GetVersion();
+    ASSERT_THROWS_INVALID_ARGUMENT(versioned_server.Update([](SearchServer &search_server) {
+        search_server.AddDocument(-1, "cat"s, DocumentStatus::ACTUAL, {});
+    }));
+    ASSERT_EQUAL(versioned_server.GetView().GetVersion(), version);
+    assert_same_results(versioned_server.GetView(), "failed update"s);
+    ASSERT_EQUAL(old_view.GetDocumentCount(), 18);
+
+    //дельта из нескольких сегментов: документы добавляются по одному и пакетом, удаляются из разных сегментов
+    VersionedSearchServer delta_server("and in the"s, 1000);
+    SearchServer delta_expected("and in the"s);
+    for (int document_id = 0; document_id < 45; ++document_id) {
+        const string &text = TEST_DOCUMENTS[document_id % TEST_DOCUMENTS.size()];
+        const DocumentStatus status = document_id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        delta_server.AddDocument(document_id, text, status, {document_id});
+        delta_expected.AddDocument(document_id, text, status, {document_id});
+    }
+    delta_server.AddDocuments({{45, "fluffy starling"s, DocumentStatus::ACTUAL, {45}}, {46, "white dog"s, DocumentStatus::BANNED, {46}}});
+    delta_expected.AddDocument(45, "fluffy starling"s, DocumentStatus::ACTUAL, {45});
+    delta_expected.AddDocument(46, "white dog"s, DocumentStatus::BANNED, {46});
+    const VersionedSearchServer::View delta_view = delta_server.GetView();
+    delta_server.RemoveDocuments({2, 33, 44, 46});
+    for (const int document_id : {2, 33, 44, 46}) {
+        delta_expected.RemoveDocument(document_id);
+    }
+    for (const string &query : {"fluffy groomed cat"s, "cat -collar and"s, "white dog starling"s}) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            AssertSameDocuments(delta_server.GetView().FindTopDocuments(query, status, 100), delta_expected.FindTopDocuments(query, status, 100),
+                                "delta segments: "s + query);
+        }
+    }
+    ASSERT_EQUAL(delta_server.GetView().GetDocumentCount(), delta_expected.GetDocumentCount());
+    ASSERT_EQUAL(delta_view.GetDocumentCount(), 47);
+    ASSERT(delta_view.HasDocument(33));
+    ASSERT(get<1>(delta_view.MatchDocument("white"s, 46)) == DocumentStatus::BANNED);
+    ASSERT(!delta_server.GetView().HasDocument(33));
+}
+
+//отсечение MaxScore и Block-Max не меняет топ: выдача совпадает с началом полного ранжирования
+void TestPrunedTopMatchesFullRanking() {
+    SearchServer search_server("and the"s);
+    //несколько блоков постингов на частое слово, чтобы блоки пропускались
+    AddGeneratedDocuments(search_server, 600);
+    search_server.RemoveDocument(7);
+
+    const auto assert_pruned_top = [&search_server](const string &hint) {
+        //при max_count не меньше числа документов отсечение не применяется
+        const size_t full_count = 1000;
+        const auto is_even = [](int document_id, DocumentStatus, int) {
+            return document_id % 2 == 0;
+        };
+        for (const string &query : {"cat dog"s, "fluffy groomed collar"s, "cat tail starling white"s, "dog eyes -cat"s,
+                                    "collar city -fluffy -dog"s}) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const vector<Document> full = search_server.FindTopDocuments(query, status, full_count);
+                const vector<Document> full_even = search_server.FindTopDocuments(query, is_even, full_count);
+                for (const size_t max_count : {size_t{1}, size_t{5}, size_t{20}}) {
+                    const vector<Document> expected(full.begin(), full.begin() + min(max_count, full.size()));
+                    AssertSameDocuments(search_server.FindTopDocuments(query, status, max_count), expected, hint + ": "s + query);
+                    AssertSameDocuments(search_server.FindTopDocuments(execution::par, query, status, max_count), expected,
+                                        hint + ": "s + query);
+                    const vector<Document> expected_even(full_even.begin(), full_even.begin() + min(max_count, full_even.size()));
+                    AssertSameDocuments(search_server.FindTopDocuments(query, is_even, max_count), expected_even, hint + ": "s + query);
+                }
+            }
+        }
+    };
+    assert_pruned_top("mutable index"s);
+    search_server.Freeze();
+    assert_pruned_top("frozen index"s);
+}
+
+//документы, добавленные и удаленные после заморозки, ищутся так же, как в незамороженном индексе,
+//а следующая заморозка дописывает хвост к замороженным спискам
+void TestFrozenIndexWithTail() {
+    SearchServer search_server("and the"s);
+    SearchServer expected("and the"s);
+    for (SearchServer *server : {&search_server, &expected}) {
+        AddGeneratedDocuments(*server, 600);
+    }
+    search_server.Freeze();
+    for (SearchServer *server : {&search_server, &expected}) {
+        AddGeneratedDocuments(*server, 300, 600);
+        //слово, которого не было при заморозке, есть только в хвосте
+        server->AddDocument(2000, "kitten cat kitten"s, DocumentStatus::ACTUAL, {2000});
+        server->AddDocuments({{2001, "kitten dog"sv, DocumentStatus::BANNED, {2001}}});
+        server->RemoveDocuments({3, 100, 650, 2001});
+        server->RemoveDocument(599);
+        server->RemoveDocument(899);
+    }
+    ASSERT(!search_server.IsFrozen());
+
+    const auto assert_same_as_expected = [&](const string &hint) {
+        ASSERT_EQUAL_HINT(search_server.GetDocumentCount(), expected.GetDocumentCount(), hint);
+        for (const string &query : {"cat dog"s, "kitten cat"s, "kitten -dog"s, "fluffy groomed collar"s, "dog eyes -cat"s,
+                                    "collar city -fluffy -dog"s}) {
+            for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                for (const size_t max_count : {size_t{1}, size_t{5}, size_t{1000}}) {
+                    const vector<Document> expected_top = expected.FindTopDocuments(query, status, max_count);
+                    AssertSameDocuments(search_server.FindTopDocuments(query, status, max_count), expected_top, hint + ": "s + query);
+                    AssertSameDocuments(search_server.FindTopDocuments(execution::par, query, status, max_count), expected_top,
+                                        hint + ": "s + query);
+                }
+            }
+        }
+        for (const int document_id : {0, 598, 600, 898, 2000}) {
+            ASSERT_HINT(search_server.MatchDocument("kitten cat dog"s, document_id) == expected.MatchDocument("kitten cat dog"s, document_id),
+                        hint);
+        }
+    };
+    assert_same_as_expected("frozen index with tail"s);
+    search_server.Freeze();
+    ASSERT(search_server.IsFrozen());
+    assert_same_as_expected("tail merged by freeze"s);
+    search_server.AddDocument(2002, "kitten starling"s, DocumentStatus::ACTUAL, {2002});
+    expected.AddDocument(2002, "kitten starling"s, DocumentStatus::ACTUAL, {2002});
+    search_server.Compact();
+    ASSERT(search_server.IsFrozen());
+    assert_same_as_expected("compacted frozen index with tail"s);
+}
+
+//кэш запросов отдает сохраненный результат, пока индекс не изменился, и не отдает устаревший после изменения
+void TestQueryCacheInvalidation() {
+    SearchServer cached_server("and in the"s);
+    SearchServer expected("and in the"s);
+    AddTestDocuments(cached_server);
+    AddTestDocuments(expected);
+    cached_server.EnableQueryCache();
+
+    const auto assert_cached_query = [&](const string &query, uint64_t hits, uint64_t misses, const string &hint) {
+        const QueryCacheStats before = cached_server.GetQueryCacheStats();
+        AssertSameDocuments(cached_server.FindTopDocuments(query), expected.FindTopDocuments(query), hint);
+        const QueryCacheStats after = cached_server.GetQueryCacheStats();
+        ASSERT_EQUAL_HINT(after.hits - before.hits, hits, hint);
+        ASSERT_EQUAL_HINT(after.misses - before.misses, misses, hint);
+    };
+    assert_cached_query("fluffy cat"s, 0, 1, "first query misses"s);
+    assert_cached_query("fluffy cat"s, 1, 0, "repeated query hits"s);
+    //ключ строится по словам запроса, а не по тексту
+    assert_cached_query("cat fluffy cat"s, 1, 0, "same words hit"s);
+    assert_cached_query("fluffy cat -collar"s, 0, 1, "minus word is part of the key"s);
+    AssertSameDocuments(cached_server.FindTopDocuments("fluffy cat"s, DocumentStatus::BANNED),
+                        expected.FindTopDocuments("fluffy cat"s, DocumentStatus::BANNED), "status is part of the key"s);
+
+    //добавление и удаление документа меняют IDF, поэтому устаревают все записи, а не только записи со словами документа
+    cached_server.AddDocument(10, "fluffy cat in the city"s, DocumentStatus::ACTUAL, {10});
+    expected.AddDocument(10, "fluffy cat in the city"s, DocumentStatus::ACTUAL, {10});
+    assert_cached_query("fluffy cat"s, 0, 1, "added document"s);
+    assert_cached_query("fluffy cat"s, 1, 0, "cached after add"s);
+    cached_server.RemoveDocument(0);
+    expected.RemoveDocument(0);
+    assert_cached_query("fluffy cat"s, 0, 1, "removed document"s);
+    cached_server.RemoveDocuments({4, 10});
+    expected.RemoveDocuments({4, 10});
+    assert_cached_query("fluffy cat -collar"s, 0, 1, "removed batch"s);
+
+    cached_server.DisableQueryCache();
+    AssertSameDocuments(cached_server.FindTopDocuments("fluffy cat"s), expected.FindTopDocuments("fluffy cat"s), "disabled cache"s);
+}
+
+//пакет с общим обходом постингов по словам выдает то же, что пакет и одиночные запросы
+void TestBatchByTermsMatchesSingleQueries() {
+    SearchServer search_server("and the"s);
+    AddGeneratedDocuments(search_server, 600);
+    search_server.RemoveDocuments({5, 6, 300});
+
+    //повторы, минус-слова, запросы только из стоп-слов и слов вне словаря
+    vector<string> queries = {"cat dog"s, "cat dog"s, "fluffy groomed collar"s, "dog eyes -cat"s, "the and"s,
+                              "unknown words"s, "collar city -fluffy -dog"s, "starling"s};
+    const vector<string> words = {"cat"s, "dog"s, "fluffy"s, "groomed"s, "collar"s, "tail"s, "eyes"s, "city"s};
+    for (size_t i = 0; i < 200; ++i) {
+        queries.push_back(words[i % words.size()] + " "s + words[(i * 7 + 3) % words.size()]
+                          + (i % 5 == 0 ? " -"s + words[(i * 3 + 1) % words.size()] : ""s));
+    }
+    const vector<string_view> query_views(queries.begin(), queries.end());
+
+    const auto assert_same_batches = [&](const string &hint) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            for (const size_t max_count : {size_t{3}, static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)}) {
+                const auto by_terms = search_server.FindTopDocumentsBatchByTerms(query_views, status, max_count);
+                const auto batch = search_server.FindTopDocumentsBatch(query_views, status, max_count);
+                ASSERT_EQUAL_HINT(by_terms.size(), queries.size(), hint);
+                ASSERT_EQUAL_HINT(batch.size(), queries.size(), hint);
+                for (size_t i = 0; i < queries.size(); ++i) {
+                    const vector<Document> expected = search_server.FindTopDocuments(queries[i], status, max_count);
+                    AssertSameDocuments(by_terms[i], expected, hint + ": "s + queries[i]);
+                    AssertSameDocuments(batch[i], expected, hint + ": "s + queries[i]);
+                }
+            }
+        }
+    };
+    assert_same_batches("mutable index"s);
+    search_server.Freeze();
+    assert_same_batches("frozen index"s);
+    search_server.SetThreadCount(2);
+    assert_same_batches("own thread pool"s);
+    ASSERT_THROWS_INVALID_ARGUMENT(search_server.FindTopDocumentsBatchByTerms({"cat"sv, "cat --dog"sv}));
+    ASSERT_THROWS_INVALID_ARGUMENT(search_server.FindTopDocumentsBatchByTerms({"cat"sv, ""sv}));
+}
+
+//скомпилированный запрос с политикой и статусом ищет так же, как запрос по тексту
+void TestCompiledQueryWithStatus() {
+    SearchServer search_server("and in the"s);
+    AddTestDocuments(search_server);
+    const SearchServer::CompiledQuery compiled_query = search_server.CompileQuery("fluffy groomed cat -starling"s);
+    const SearchServer::CompiledQuery new_word_query = search_server.CompileQuery("eugene kitten"s);
+
+    const auto assert_same_results = [&search_server](const SearchServer::CompiledQuery &query, const string &raw_query, const string &hint) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const vector<Document> expected = search_server.FindTopDocuments(raw_query, status);
+            AssertSameDocuments(search_server.FindTopDocuments(execution::seq, query, status), expected, hint);
+            AssertSameDocuments(search_server.FindTopDocuments(execution::par, query, status), expected, hint);
+            AssertSameDocuments(search_server.FindTopDocuments(query, status), expected, hint);
+            AssertSameDocuments(search_server.FindTopDocuments(execution::par, query, status, 1),
+                                search_server.FindTopDocuments(raw_query, status, 1), hint);
+        }
+    };
+    assert_same_results(compiled_query, "fluffy groomed cat -starling"s, "compiled query"s);
+    //слово, появившееся в словаре после компиляции, дописывается в запрос при поиске
+    search_server.AddDocument(10, "fluffy kitten"s, DocumentStatus::ACTUAL, {10});
+    search_server.AddDocument(11, "groomed kitten"s, DocumentStatus::BANNED, {11});
+    assert_same_results(new_word_query, "eugene kitten"s, "resolved query"s);
+    assert_same_results(compiled_query, "fluffy groomed cat -starling"s, "compiled query after add"s);
+}
+
+//таблица стоп-слов узнает каждое стоп-слово и только их, ячеек в ней столько же, сколько слов
+void TestStopWordFilter() {
+    ASSERT(!StopWordFilter().Contains("and"s));
+    const StopWordFilter empty_filter(set<string, less<>>{});
+    ASSERT(!empty_filter.Contains("and"s));
+    ASSERT(!empty_filter.Contains(""s));
+
+    for (const size_t word_count : {size_t{1}, size_t{2}, size_t{3}, size_t{17}, size_t{1000}}) {
+        set<string, less<>> stop_words;
+        uint32_t seed = static_cast<uint32_t>(word_count);
+        while (stop_words.size() < word_count) {
+            string word;
+            seed = seed * 1103515245u + 12345u;
+            for (uint32_t length = 2 + (seed >> 16) % 12; length > 0; --length) {
+                seed = seed * 1103515245u + 12345u;
+                word += static_cast<char>('a' + (seed >> 16) % 26);
+            }
+            stop_words.insert(word);
+        }
+        const StopWordFilter filter(stop_words);
+        const string hint = to_string(word_count) + " stop words"s;
+        ASSERT_EQUAL_HINT(filter.GetSlotCount(), word_count, hint);
+        for (const string &word : stop_words) {
+            ASSERT_HINT(filter.Contains(word), hint + ": "s + word);
+            //префиксы, продолжения и слова с другой буквой не стоп-слова, если их нет в наборе
+            for (const string &other : {word.substr(0, word.size() - 1), word + "s"s, "x"s + word, word.substr(1),
+                                        string(word.size(), '#')}) {
+                ASSERT_EQUAL_HINT(filter.Contains(other), stop_words.count(other) > 0, hint + ": "s + other);
+            }
+        }
+    }
+
+    //таблица времени компиляции проверяется компилятором и дает серверу ту же выдачу, что и стоп-слова строкой
+    constexpr auto static_filter = MakeStopWordFilter("and", "in", "the", "a");
+    static_assert(static_filter.Contains("and") && static_filter.Contains("a") && static_filter.Contains("the"));
+    static_assert(!static_filter.Contains("an") && !static_filter.Contains("then") && !static_filter.Contains(""));
+    const StopWordFilter copied_filter(static_filter);
+    ASSERT_EQUAL(copied_filter.GetSlotCount(), 4u);
+    ASSERT(copied_filter.Contains("in"s) && !copied_filter.Contains("i"s) && !copied_filter.Contains("ins"s));
+    SearchServer static_server(static_filter);
+    SearchServer expected("and in the a"s);
+    AddTestDocuments(static_server);
+    AddTestDocuments(expected);
+    AssertSameResults(static_server, expected, "static stop words"s);
+}
+
+//метод запускает тесты поисковой системы
+//замороженный индекс возвращает добавленные постинги после сжатия, копирования слотов без распаковки и снимка
+void TestFrozenIndexRoundTrip() {
+    //длинный список на несколько блоков, пустой список и список из одного постинга
+    vector<vector<FrozenPosting>> lists(3);
+    for (int ordinal = 0; ordinal < 1000; ordinal += 3) {
+        const uint32_t count = 1 + ordinal % 5;
+        lists[0].push_back({ordinal, count, 0.1 * count});
+    }
+    lists[2].push_back({999, 2, 0.25});
+    FrozenIndex index;
+    for (size_t slot = 0; slot < lists.size(); ++slot) {
+        ASSERT_EQUAL(index.AddPostings(lists[slot]), slot);
+    }
+    AssertSameFrozenPostings(index, lists, "built index"s);
+    ASSERT_EQUAL(index.GetPostingCount(), lists[0].size() + 1);
+    ASSERT(!index.Contains(0, 1));
+    ASSERT(!index.Contains(1, 0));
+    ASSERT(!index.Contains(2, 998));
+    ASSERT(abs(index.GetMaxWeight(0) - 0.5) < 1e-12);
+    ASSERT_EQUAL(index.GetMaxWeight(1), 0.0);
+
+    //обход отрезка номеров не выходит за его границы
+    vector<int> ordinals;
+    index.ForEach(0, 300, 310, [&ordinals](int ordinal, uint32_t) {
+        ordinals.push_back(ordinal);
+    });
+    ASSERT(ordinals == vector<int>({300, 303, 306, 309}));
+
+    FrozenIndex copied;
+    for (size_t slot = 0; slot < lists.size(); ++slot) {
+        copied.AddPostings(index, slot);
+    }
+    AssertSameFrozenPostings(copied, lists, "copied slots"s);
+    ASSERT(abs(copied.GetMaxWeight(0) - 0.5) < 1e-12);
+
+    const FrozenIndex attached = SaveAndAttach(index, 1000, MakeTemporaryPath("frozen_index"s));
+    AssertSameFrozenPostings(attached, lists, "attached snapshot"s);
+    //копия подключенного индекса переживает подключение
+    FrozenIndex materialized = attached;
+    materialized.AddPostings({{5, 1, 1.0}});
+    lists.push_back({{5, 1, 1.0}});
+    AssertSameFrozenPostings(materialized, lists, "copy of attached snapshot"s);
+}
+
+//копия словаря ищет слова по своим строкам и переживает исходный словарь
+void TestTermDictionaryCopy() {
+    auto source = make_unique<TermDictionary>();
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "cat"s};
+    for (const string &word : words) {
+        source->Intern(word);
+    }
+    ASSERT_EQUAL(source->GetSize(), 3u);
+
+    const TermDictionary copied(*source);
+    TermDictionary assigned;
+    assigned.Intern("hamster"s);
+    assigned = *source;
+    const string_view copied_word = copied.GetWord(1);
+    source.reset();
+
+    for (const TermDictionary *dictionary : {&copied, static_cast<const TermDictionary *>(&assigned)}) {
+        ASSERT_EQUAL(dictionary->GetSize(), 3u);
+        ASSERT_EQUAL(dictionary->Find("cat"s), 0u);
+        ASSERT_EQUAL(dictionary->Find("dog"s), 1u);
+        ASSERT_EQUAL(dictionary->Find("parrot"s), 2u);
+        ASSERT_EQUAL(dictionary->Find("hamster"s), TermDictionary::NO_TERM);
+        ASSERT_EQUAL(dictionary->GetWord(2), "parrot"s);
+    }
+    ASSERT_EQUAL(copied_word, "dog"s);
+
+    //копия пополняется независимо от другой копии
+    TermDictionary extended = copied;
+    ASSERT_EQUAL(extended.Intern("hamster"s), 3u);
+    ASSERT_EQUAL(extended.Intern("dog"s), 1u);
+    ASSERT_EQUAL(copied.Find("hamster"s), TermDictionary::NO_TERM);
+    ASSERT_EQUAL(extended.GetSize(), 4u);
+}
+
+//отбор лучших документов совпадает с сортировкой всех документов, в том числе при равной релевантности и K > N
+void TestTopDocumentsSelection() {
+    vector<Document> documents;
+    for (int id = 0; id < 40; ++id) {
+        //релевантности повторяются и отличаются меньше, чем на PRECISION, рейтинги тоже повторяются
+        documents.push_back(Document(id, 0.1 * (id % 4) + (id % 2) * PRECISION / 4, id % 7));
+    }
+    vector<Document> sorted = documents;
+    sort(sorted.begin(), sorted.end(), IsRankedHigher);
+
+    for (const size_t max_count : {0u, 1u, 5u, 13u, 40u, 100u}) {
+        TopDocuments top(max_count);
+        for (const Document &document : documents) {
+            top.Add(document);
+        }
+        const vector<Document> selected = top.Release();
+        const string hint = "max_count = "s + to_string(max_count);
+        ASSERT_EQUAL_HINT(selected.size(), min(max_count, documents.size()), hint);
+        for (size_t i = 0; i < selected.size(); ++i) {
+            //при полном равенстве документы взаимозаменяемы, поэтому сравниваются релевантность и рейтинг
+            ASSERT_HINT(abs(selected[i].relevance - sorted[i].relevance) < PRECISION, hint);
+            ASSERT_EQUAL_HINT(selected[i].rating, sorted[i].rating, hint);
+        }
+    }
+
+    //слияние отборов двух потоков совпадает с общим отбором
+    TopDocuments left(5), right(5);
+    for (const Document &document : documents) {
+        (document.id % 2 == 0 ? left : right).Add(document);
+    }
+    left.Merge(right);
+    const vector<Document> merged = left.Release();
+    ASSERT_EQUAL(merged.size(), 5u);
+    for (size_t i = 0; i < merged.size(); ++i) {
+        ASSERT(abs(merged[i].relevance - sorted[i].relevance) < PRECISION);
+        ASSERT_EQUAL(merged[i].rating, sorted[i].rating);
+    }
+}
+
+//накопитель из пула приходит чистым после предыдущего запроса, в том числе с другим отрезком номеров
+void TestScoreAccumulatorReuse() {
+    ScoreAccumulatorPool pool;
+    const ScoreAccumulator *first_accumulator = nullptr;
+    {
+        auto accumulator = pool.Acquire(10);
+        first_accumulator = &*accumulator;
+        accumulator->Add(3, 1.0);
+        accumulator->Add(3, 0.5);
+        accumulator->Add(7, 2.0);
+        accumulator->Exclude(7);
+        accumulator->Exclude(9);
+        accumulator->Add(9, 1.0);
+        ASSERT_EQUAL(accumulator->GetTouchedCount(), 3u);
+        vector<pair<int, double>> scores;
+        accumulator->ForEach([&scores](int ordinal, double score) {
+            scores.emplace_back(ordinal, score);
+        });
+        ASSERT(scores == (vector<pair<int, double>>{{3, 1.5}}));
+    }
+    {
+        //тот же накопитель на большем отрезке, начинающемся не с нуля
+        auto accumulator = pool.Acquire(20, 100);
+        ASSERT(&*accumulator == first_accumulator);
+        ASSERT_EQUAL(accumulator->GetTouchedCount(), 0u);
+        accumulator->Add(107, 1.0);
+        accumulator->Add(119, 0.25);
+        accumulator->Add(109, 3.0);
+        vector<pair<int, double>> scores;
+        accumulator->ForEach([&scores](int ordinal, double score) {
+            scores.emplace_back(ordinal, score);
+        });
+        ASSERT(scores == (vector<pair<int, double>>{{107, 1.0}, {119, 0.25}, {109, 3.0}}));
+        //второй одновременный запрос получает отдельный накопитель
+        auto other = pool.Acquire(10);
+        ASSERT(&*other != &*accumulator);
+        ASSERT_EQUAL(other->GetTouchedCount(), 0u);
+    }
+
+    //поиск, чередующий запросы на одном сервере, не переносит счета между ними
+    SearchServer search_server("и в на"s);
+    AddGeneratedDocuments(search_server, 300);
+    for (const string &query : TEST_QUERIES) {
+        SearchServer fresh_server("и в на"s);
+        AddGeneratedDocuments(fresh_server, 300);
+        const vector<Document> expected = fresh_server.FindTopDocuments(query);
+        for (int repeat = 0; repeat < 2; ++repeat) {
+            AssertSameDocuments(search_server.FindTopDocuments(query), expected, query);
+            AssertSameDocuments(search_server.FindTopDocuments(execution::par, query), expected, "par "s + query);
+        }
+    }
+}
+
+//параллельный поиск по отрезкам номеров документов совпадает с однопоточным, в том числе
+//на пуле пакетных запросов, размер которого задает число отрезков независимо от числа ядер
+void TestParallelSlicesMatchSequential() {
+    SearchServer search_server("and the"s);
+    AddGeneratedDocuments(search_server, 20000);
+    search_server.RemoveDocuments({5, 4096, 12000});
+    search_server.SetThreadCount(4);
+    const auto any_document = [](int, DocumentStatus, int) {
+        return true;
+    };
+    //частого слова хватает на четыре отрезка по MIN_POSTINGS_PER_SLICE постингов
+    ASSERT(search_server.FindTopDocuments("cat"s, any_document, 20000).size() >= 4 * MIN_POSTINGS_PER_SLICE);
+
+    const vector<string> queries = {"cat dog"s, "cat fluffy -dog"s, "cat groomed collar tail"s, "dog -cat"s, "cat"s};
+    const vector<string_view> query_views(queries.begin(), queries.end());
+    for (const size_t max_count : {size_t{5}, size_t{20000}}) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const vector<vector<Document>> batch = search_server.FindTopDocumentsBatch(query_views, status, max_count);
+            for (size_t i = 0; i < queries.size(); ++i) {
+                const string hint = queries[i] + ", max_count = "s + to_string(max_count);
+                const vector<Document> expected = search_server.FindTopDocuments(execution::seq, queries[i], status, max_count);
+                AssertSameDocuments(search_server.FindTopDocuments(execution::par, queries[i], status, max_count), expected, hint);
+                AssertSameDocuments(batch[i], expected, "batch "s + hint);
+            }
+        }
+    }
+}
+
+//IDF, поддерживаемый при добавлении и удалении документов, совпадает с посчитанным заново по живым документам
+void TestInverseDocumentFreqAfterChanges() {
+    SearchServer search_server(""s);
+    map<int, vector<string>> documents;
+    const auto add_document = [&](int document_id, const string &text) {
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {1});
+        const vector<string_view> words = SplitIntoWords(text);
+        documents[document_id] = vector<string>(words.begin(), words.end());
+    };
+    //релевантность по определению: сумма TF * log(N / df) по словам запроса
+    const auto assert_relevances = [&](const string &hint) {
+        for (const vector<string> &query : {vector<string>{"cat"s}, vector<string>{"cat"s, "bird"s}, vector<string>{"dog"s, "fish"s}}) {
+            map<int, double> expected;
+            for (const string &word : query) {
+                const auto document_freq = count_if(documents.begin(), documents.end(), [&word](const auto &document) {
+                    return count(document.second.begin(), document.second.end(), word) > 0;
+                });
+                for (const auto &[document_id, words] : documents) {
+                    const auto word_count = count(words.begin(), words.end(), word);
+                    if (word_count > 0) {
+                        expected[document_id] += static_cast<double>(word_count) / words.size()
+                                * log(static_cast<double>(documents.size()) / document_freq);
+                    }
+                }
+            }
+            string raw_query = query.front();
+            for (size_t i = 1; i < query.size(); ++i) {
+                raw_query += " "s + query[i];
+            }
+            const vector<Document> found = search_server.FindTopDocuments(raw_query, DocumentStatus::ACTUAL, documents.size());
+            ASSERT_EQUAL_HINT(found.size(), expected.size(), hint + ": "s + raw_query);
+            for (const Document &document : found) {
+                ASSERT_HINT(expected.count(document.id) > 0, hint + ": "s + raw_query);
+                ASSERT_HINT(abs(document.relevance - expected.at(document.id)) < 1e-12, hint + ": "s + raw_query);
+            }
+        }
+    };
+
+    add_document(1, "cat dog"s);
+    add_document(2, "cat"s);
+    add_document(3, "dog bird"s);
+    add_document(4, "bird bird cat"s);
+    assert_relevances("initial"s);
+    add_document(5, "fish cat"s);
+    add_document(6, "fish fish dog"s);
+    assert_relevances("after add"s);
+    search_server.RemoveDocument(2);
+    documents.erase(2);
+    assert_relevances("after remove"s);
+    search_server.RemoveDocument(execution::par, 6);
+    documents.erase(6);
+    assert_relevances("after parallel remove"s);
+    //слово исчезает из всех документов, а затем появляется снова
+    search_server.RemoveDocuments({5, 3});
+    documents.erase(5);
+    documents.erase(3);
+    assert_relevances("after batch remove"s);
+    add_document(7, "fish bird"s);
+    add_document(8, "cat cat cat dog"s);
+    assert_relevances("after re-add"s);
+}
+
+//пакетное удаление дает тот же индекс, что и удаление документов по одному: неизвестные и повторные id пропускаются
+void TestRemoveDocumentsBatch() {
+    //каждый третий документ и длинный отрезок подряд, повторы, неизвестные id и документ, удаляемый дважды
+    vector<int> document_ids = {10000, 17, 17, -5, 599, 0};
+    for (int document_id = 3; document_id < 600; document_id += 3) {
+        document_ids.push_back(document_id);
+    }
+    for (int document_id = 200; document_id < 260; ++document_id) {
+        document_ids.push_back(document_id);
+    }
+
+    SearchServer expected("and the"s);
+    AddGeneratedDocuments(expected, 600);
+    for (const int document_id : document_ids) {
+        expected.RemoveDocument(document_id);
+    }
+    const set<int> removed(document_ids.begin(), document_ids.end());
+    ASSERT_EQUAL(expected.GetDocumentCount(), 600 - static_cast<int>(count_if(removed.begin(), removed.end(), [](int document_id) {
+        return document_id >= 0 && document_id < 600;
+    })));
+
+    SearchServer batch("and the"s);
+    SearchServer parallel_batch("and the"s);
+    SearchServer tombstone_batch("and the"s);
+    tombstone_batch.EnableTombstones(1.0);
+    for (SearchServer *server : {&batch, &parallel_batch, &tombstone_batch}) {
+        AddGeneratedDocuments(*server, 600);
+    }
+    batch.RemoveDocuments(document_ids);
+    parallel_batch.RemoveDocuments(execution::par, document_ids);
+    tombstone_batch.RemoveDocuments(execution::seq, document_ids);
+    //повторное удаление тех же документов ничего не меняет
+    batch.RemoveDocuments(document_ids);
+
+    for (const auto &[server, hint] : {pair{&batch, "batch"s}, pair{&parallel_batch, "parallel batch"s},
+                                       pair{&tombstone_batch, "tombstone batch"s}}) {
+        ASSERT_EQUAL_HINT(server->GetDocumentCount(), expected.GetDocumentCount(), hint);
+        ASSERT_HINT(set<int>(server->begin(), server->end()) == set<int>(expected.begin(), expected.end()), hint);
+        ASSERT_HINT(server->GetWordFrequencies(17).empty(), hint);
+        ASSERT_HINT(server->GetWordFrequencies(1) == expected.GetWordFrequencies(1), hint);
+        AssertSameResults(*server, expected, hint);
+    }
+    tombstone_batch.Compact();
+    AssertSameResults(tombstone_batch, expected, "compacted tombstone batch"s);
+}
+
+//параллельное пакетное добавление дает тот же индекс, что и добавление документов по одному,
+//а ошибка в любом документе пакета бросает invalid_argument до изменения индекса
+void TestAddDocumentsMatchesSequentialAdds() {
+    const vector<string> words = {"cat"s, "dog"s, "fluffy"s, "groomed"s, "collar"s, "tail"s, "eyes"s, "and"s, "the"s};
+    vector<string> texts;
+    uint32_t seed = 7;
+    for (int document_id = 0; document_id < 3000; ++document_id) {
+        string text;
+        for (int i = 0; i < 1 + document_id % 9; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            text += (i == 0 ? ""s : " "s) + words[(seed >> 16) % words.size()];
+        }
+        texts.push_back(move(text));
+    }
+    vector<NewDocument> documents;
+    for (int document_id = 0; document_id < static_cast<int>(texts.size()); ++document_id) {
+        const DocumentStatus status = document_id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        documents.push_back({document_id, texts[document_id], status, {document_id, -document_id % 5}});
+    }
+
+    SearchServer expected("and the"s);
+    for (const NewDocument &document : documents) {
+        expected.AddDocument(document.id, document.text, document.status, document.ratings);
+    }
+    SearchServer parallel_batch("and the"s);
+    parallel_batch.AddDocuments(execution::par, documents);
+    //пакет поверх уже непустого индекса
+    SearchServer split_batch("and the"s);
+    split_batch.AddDocuments(execution::seq, vector<NewDocument>(documents.begin(), documents.begin() + 1000));
+    split_batch.AddDocuments(execution::par, vector<NewDocument>(documents.begin() + 1000, documents.end()));
+    for (const auto &[server, hint] : {pair{&parallel_batch, "parallel batch"s}, pair{&split_batch, "split batch"s}}) {
+        ASSERT_EQUAL_HINT(server->GetDocumentCount(), expected.GetDocumentCount(), hint);
+        for (const int document_id : {0, 1, 999, 1000, 2999}) {
+            ASSERT_HINT(server->GetWordFrequencies(document_id) == expected.GetWordFrequencies(document_id), hint);
+            ASSERT_HINT(server->MatchDocument("cat collar -tail"s, document_id) == expected.MatchDocument("cat collar -tail"s, document_id), hint);
+        }
+        AssertSameResults(*server, expected, hint);
+    }
+
+    //повтор id внутри пакета, id уже в индексе, отрицательный id и недопустимое слово
+    const vector<vector<NewDocument>> bad_batches = {
+            {{5000, "cat"sv, DocumentStatus::ACTUAL, {1}}, {5000, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+            {{5001, "cat"sv, DocumentStatus::ACTUAL, {1}}, {10, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+            {{5002, "cat"sv, DocumentStatus::ACTUAL, {1}}, {-1, "dog"sv, DocumentStatus::ACTUAL, {1}}},
+            {{5003, "cat"sv, DocumentStatus::ACTUAL, {1}}, {5004, "d\x12og"sv, DocumentStatus::ACTUAL, {1}}},
+    };
+    for (const vector<NewDocument> &bad_batch : bad_batches) {
+        for (const bool is_parallel : {false, true}) {
+            try {
+                if (is_parallel) {
+                    parallel_batch.AddDocuments(execution::par, bad_batch);
+                } else {
+                    parallel_batch.AddDocuments(execution::seq, bad_batch);
+                }
+                ASSERT_HINT(false, "bad batch must be rejected"s);
+            } catch (const invalid_argument &) {
+            }
+            ASSERT_EQUAL(parallel_batch.GetDocumentCount(), expected.GetDocumentCount());
+            ASSERT(parallel_batch.GetWordFrequencies(bad_batch.front().id).empty());
+        }
+    }
+    AssertSameResults(parallel_batch, expected, "after rejected batches"s);
+}
+
+//блоки с полями в 1, 2 и 4 байта, в том числе разной ширины в одном списке, распаковываются без потерь
+void TestFrozenIndexBlockWidths() {
+    vector<vector<FrozenPosting>> lists(5);
+    //разности и числа вхождений в 1 байт, последний блок неполный
+    for (int i = 0; i < 300; ++i) {
+        lists[0].push_back({i, static_cast<uint32_t>(1 + i % 255), 1.0});
+    }
+    //разности и числа вхождений в 2 байта
+    for (int i = 0; i < 200; ++i) {
+        lists[1].push_back({300 * i + 299, static_cast<uint32_t>(256 + 300 * i), 1.0});
+    }
+    //разности в 4 байта, числа вхождений в 1 байт
+    for (int i = 0; i < 200; ++i) {
+        lists[2].push_back({70000 * i, static_cast<uint32_t>(1 + i % 3), 1.0});
+    }
+    //ширина меняется от блока к блоку
+    int ordinal = 0;
+    for (int i = 0; i < 3 * static_cast<int>(POSTING_BLOCK_SIZE); ++i) {
+        const int block = i / static_cast<int>(POSTING_BLOCK_SIZE);
+        ordinal += block == 0 ? 1 : block == 1 ? 1000 : 100000;
+        const uint32_t count = block == 0 ? 2 : block == 1 ? 70000 + i : numeric_limits<uint32_t>::max() - i;
+        lists[3].push_back({ordinal, count, 1.0});
+    }
+    //единственный постинг с наибольшими значениями
+    lists[4].push_back({2000000000, numeric_limits<uint32_t>::max(), 1.0});
+
+    FrozenIndex index;
+    for (const vector<FrozenPosting> &postings : lists) {
+        index.AddPostings(postings);
+    }
+    AssertSameFrozenPostings(index, lists, "built index"s);
+    FrozenIndex copied;
+    for (size_t slot = 0; slot < lists.size(); ++slot) {
+        copied.AddPostings(index, slot);
+    }
+    AssertSameFrozenPostings(copied, lists, "copied slots"s);
+    AssertSameFrozenPostings(SaveAndAttach(index, 2000000001, MakeTemporaryPath("frozen_widths"s)), lists, "attached snapshot"s);
+}
+
+//курсор замороженного индекса: Next проходит все постинги, Seek встает на первый постинг с номером не меньше
+//заданного, PeekBlock возвращает границу блока, не сдвигая курсор
+void TestFrozenIndexCursor() {
+    vector<FrozenPosting> postings;
+    for (int i = 0; i < 1000; ++i) {
+        const uint32_t count = 1 + (i * 7) % 13;
+        postings.push_back({3 * i + 1, count, 0.1 * count});
+    }
+    FrozenIndex index;
+    const size_t slot = index.AddPostings(postings);
+    const size_t empty_slot = index.AddPostings({});
+
+    //границы блоков по определению
+    vector<FrozenIndex::BlockBound> bounds;
+    for (size_t i = 0; i < postings.size(); ++i) {
+        if (i % POSTING_BLOCK_SIZE == 0) {
+            bounds.push_back({0.0, 0});
+        }
+        bounds.back().max_weight = max(bounds.back().max_weight, postings[i].weight);
+        bounds.back().last_ordinal = postings[i].ordinal;
+    }
+    const auto find_posting = [&postings](size_t first, int ordinal) {
+        return static_cast<size_t>(lower_bound(postings.begin() + first, postings.end(), ordinal, [](const FrozenPosting &posting, int value) {
+            return posting.ordinal < value;
+        }) - postings.begin());
+    };
+    const auto assert_peek = [&](const FrozenIndex::Cursor &cursor, size_t position, int ordinal) {
+        //курсор за концом списка уже не стоит ни в одном блоке
+        size_t block = position == postings.size() ? bounds.size() : position / POSTING_BLOCK_SIZE;
+        while (block < bounds.size() && bounds[block].last_ordinal < ordinal) {
+            ++block;
+        }
+        const FrozenIndex::BlockBound bound = cursor.PeekBlock(ordinal);
+        const string hint = "peek "s + to_string(ordinal) + " at posting "s + to_string(position);
+        if (block == bounds.size()) {
+            ASSERT_EQUAL_HINT(bound.max_weight, 0.0, hint);
+            ASSERT_EQUAL_HINT(bound.last_ordinal, numeric_limits<int>::max(), hint);
+        } else {
+            ASSERT_EQUAL_HINT(bound.max_weight, bounds[block].max_weight, hint);
+            ASSERT_EQUAL_HINT(bound.last_ordinal, bounds[block].last_ordinal, hint);
+        }
+    };
+
+    FrozenIndex::Cursor cursor(index, slot);
+    for (const FrozenPosting &posting : postings) {
+        ASSERT(!cursor.IsEnd());
+        ASSERT_EQUAL(cursor.GetOrdinal(), posting.ordinal);
+        ASSERT_EQUAL(cursor.GetCount(), posting.count);
+        cursor.Next();
+    }
+    ASSERT(cursor.IsEnd());
+
+    //переходы внутри блока, через несколько блоков, на границу блока, назад (курсор стоит) и за конец
+    FrozenIndex::Cursor seeking(index, slot);
+    size_t position = 0;
+    for (const int target : {0, 1, 5, 5, 2, 383, 385, 386, 1000, 1900, 2998, 2999}) {
+        for (const int peeked : {target, target + 1, target + 500, 5000}) {
+            assert_peek(seeking, position, peeked);
+        }
+        seeking.Seek(target);
+        position = find_posting(position, target);
+        const string hint = "seek "s + to_string(target);
+        if (position == postings.size()) {
+            ASSERT_HINT(seeking.IsEnd(), hint);
+        } else {
+            ASSERT_HINT(!seeking.IsEnd(), hint);
+            ASSERT_EQUAL_HINT(seeking.GetOrdinal(), postings[position].ordinal, hint);
+            ASSERT_EQUAL_HINT(seeking.GetCount(), postings[position].count, hint);
+        }
+    }
+    seeking.Seek(3001);
+    ASSERT(seeking.IsEnd());
+    assert_peek(seeking, postings.size(), 0);
+
+    FrozenIndex::Cursor empty(index, empty_slot);
+    ASSERT(empty.IsEnd());
+    ASSERT_EQUAL(empty.PeekBlock(0).last_ordinal, numeric_limits<int>::max());
+    empty.Seek(10);
+    ASSERT(empty.IsEnd());
+}
+
+//разбиение на слова блоками совпадает с побайтовым: пробелы подряд, в начале и в конце дают пустые слова,
+//управляющие символы находятся в любом месте, в том числе на границах блоков по 16 и 32 байта
+void TestSplitIntoWordsMatchesScalar() {
+    const auto split_scalar = [](string_view text, vector<string_view> &words) {
+        words.clear();
+        bool is_valid = true;
+        size_t word_begin = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            if (text[i] == ' ') {
+                words.push_back(text.substr(word_begin, i - word_begin));
+                word_begin = i + 1;
+            } else if (text[i] >= '\0' && text[i] < ' ') {
+                is_valid = false;
+            }
+        }
+        words.push_back(text.substr(word_begin));
+        return is_valid;
+    };
+    const auto assert_same_split = [&split_scalar](const string &text) {
+        vector<string_view> expected;
+        vector<string_view> words = {"stale"sv};
+        const bool expected_is_valid = split_scalar(text, expected);
+        const string hint = "text of "s + to_string(text.size()) + " bytes"s;
+        ASSERT_EQUAL_HINT(SplitIntoWords(text, words), expected_is_valid, hint);
+        ASSERT_EQUAL_HINT(words.size(), expected.size(), hint);
+        for (size_t i = 0; i < words.size(); ++i) {
+            //слова — представления исходного текста, а не копии
+            ASSERT_HINT(words[i].data() == expected[i].data() && words[i].size() == expected[i].size(), hint);
+        }
+        ASSERT_HINT(SplitIntoWords(text) == expected, hint);
+    };
+
+    //управляющий символ и пробел в каждой позиции вокруг границ блоков
+    for (const size_t size : {0u, 1u, 15u, 16u, 17u, 31u, 32u, 33u, 63u, 64u, 65u, 100u}) {
+        assert_same_split(string(size, 'a'));
+        assert_same_split(string(size, ' '));
+        for (size_t position = 0; position < size; ++position) {
+            for (const char c : {' ', '\0', '\x01', '\t', '\x1f', '\x7f', '\x80', '\xff'}) {
+                string text(size, 'a');
+                text[position] = c;
+                assert_same_split(text);
+            }
+        }
+    }
+    //случайные тексты из букв, пробелов, управляющих символов и байтов UTF-8
+    const string alphabet = "ab- \x01\x1f\x7f\xd0\xb0\xff"s;
+    uint32_t seed = 3;
+    for (int i = 0; i < 2000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        string text((seed >> 16) % 100, 'a');
+        for (char &c : text) {
+            seed = seed * 1103515245u + 12345u;
+            //управляющие символы редки, чтобы часть текстов оставалась допустимой
+            const size_t index = (seed >> 16) % 64;
+            c = index < 40 ? "ab"[index % 2] : index < 56 ? ' ' : alphabet[index % alphabet.size()];
+        }
+        assert_same_split(text);
+    }
+}
+
+//вектор с внутренним местом ведет себя как std::vector до и после переполнения, после удаления и очистки
+void TestSmallVectorSpill() {
+    SmallVector<int, 4> values;
+    vector<int> expected;
+    const auto assert_same = [&values, &expected](const string &hint) {
+        ASSERT_EQUAL_HINT(values.size(), expected.size(), hint);
+        ASSERT_EQUAL_HINT(values.empty(), expected.empty(), hint);
+        ASSERT_HINT(vector<int>(values.begin(), values.end()) == expected, hint);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL_HINT(values[i], expected[i], hint);
+        }
+    };
+    assert_same("empty"s);
+    for (int value = 0; value < 12; ++value) {
+        values.push_back(value * value);
+        expected.push_back(value * value);
+        assert_same("push_back "s + to_string(value));
+    }
+
+    //копия независима от исходного вектора
+    SmallVector<int, 4> copied = values;
+    values[0] = -1;
+    expected[0] = -1;
+    ASSERT_EQUAL(copied[0], 0);
+    ASSERT_EQUAL(copied.size(), 12u);
+
+    values.erase(values.begin() + 2, values.begin() + 5);
+    expected.erase(expected.begin() + 2, expected.begin() + 5);
+    assert_same("erase in the middle"s);
+    //после удаления до размера внутреннего места элементы остаются в куче и доступны
+    values.erase(values.begin() + 1, values.end() - 2);
+    expected.erase(expected.begin() + 1, expected.end() - 2);
+    assert_same("erase down to inline capacity"s);
+    values.push_back(7);
+    expected.push_back(7);
+    assert_same("push_back after erase"s);
+    values.erase(values.begin(), values.end());
+    expected.clear();
+    assert_same("erase all"s);
+    //опустевший вектор снова заполняет внутреннее место и снова переполняется
+    for (int value = 0; value < 6; ++value) {
+        values.push_back(value);
+        expected.push_back(value);
+        assert_same("refill "s + to_string(value));
+    }
+    values.clear();
+    expected.clear();
+    assert_same("clear"s);
+
+    SmallVector<uint32_t, 1> single;
+    single.push_back(5);
+    single.push_back(6);
+    single.erase(single.begin(), single.begin() + 1);
+    ASSERT_EQUAL(single.size(), 1u);
+    ASSERT_EQUAL(single[0], 6u);
+}
+
+//вложенный ParallelFor не блокирует пул и вызывает функцию ровно один раз для каждого номера,
+//исключение бросается вызывающему после завершения всех вызовов, и пул остается рабочим
+void TestThreadPoolParallelFor() {
+    for (const size_t thread_count : {size_t{0}, size_t{1}, size_t{3}}) {
+        const ThreadPool pool(thread_count);
+        const string hint = to_string(thread_count) + " threads"s;
+
+        //три уровня вложенности: номеров больше, чем потоков, на каждом уровне
+        vector<atomic<int>> calls(8 * 6 * 5);
+        pool.ParallelFor(8, [&](size_t outer) {
+            pool.ParallelFor(6, [&](size_t middle) {
+                pool.ParallelFor(5, [&](size_t inner) {
+                    ++calls[(outer * 6 + middle) * 5 + inner];
+                });
+            });
+        });
+        ASSERT_HINT(all_of(calls.begin(), calls.end(), [](const atomic<int> &call_count) {
+            return call_count == 1;
+        }), hint);
+
+        atomic<int> call_count = 0;
+        try {
+            pool.ParallelFor(100, [&call_count](size_t index) {
+                ++call_count;
+                if (index == 37 || index == 80) {
+                    throw runtime_error("index "s + to_string(index));
+                }
+            });
+            ASSERT_HINT(false, hint + ": exception must be rethrown"s);
+        } catch (const runtime_error &error) {
+            ASSERT_HINT(error.what() == "index 37"s || error.what() == "index 80"s, hint);
+        }
+        ASSERT_EQUAL_HINT(call_count.load(), 100, hint);
+
+        //исключение вложенного вызова доходит через внешний
+        call_count = 0;
+        try {
+            pool.ParallelFor(4, [&](size_t outer) {
+                pool.ParallelFor(10, [&](size_t inner) {
+                    ++call_count;
+                    if (outer == 2 && inner == 9) {
+                        throw invalid_argument("nested"s);
+                    }
+                });
+            });
+            ASSERT_HINT(false, hint + ": nested exception must be rethrown"s);
+        } catch (const invalid_argument &) {
+        }
+        ASSERT_EQUAL_HINT(call_count.load(), 40, hint);
+
+        //после исключений пул выполняет вызовы из нескольких внешних потоков
+        vector<atomic<int>> sums(4);
+        vector<thread> callers;
+        for (size_t caller = 0; caller < sums.size(); ++caller) {
+            callers.emplace_back([&pool, &sums, caller] {
+                pool.ParallelFor(1000, [&sums, caller](size_t index) {
+                    sums[caller] += static_cast<int>(index);
+                });
+            });
+        }
+        for (thread &caller : callers) {
+            caller.join();
+        }
+        for (const atomic<int> &sum : sums) {
+            ASSERT_EQUAL_HINT(sum.load(), 999 * 1000 / 2, hint);
+        }
+    }
+}
+
+//потоковая выдача пакета: при QUERY_ORDER результаты приходят строго по порядку запросов, вызовы callback
+//не пересекаются, а результаты совпадают с пакетом списком; JoinedDocuments раскладывает их по смещениям
+void TestStreamedAndJoinedResults() {
+    SearchServer search_server("and the"s);
+    AddGeneratedDocuments(search_server, 3000);
+    search_server.SetThreadCount(3);
+    //тяжелые и легкие запросы вперемешку, чтобы поздние запросы часто заканчивались раньше ранних
+    vector<string> queries;
+    for (int i = 0; i < 40; ++i) {
+        queries.push_back(i % 4 == 0 ? "cat dog fluffy"s : i % 4 == 1 ? "starling"s : i % 4 == 2 ? "kitten"s : "white -cat"s);
+    }
+    const vector<string_view> query_views(queries.begin(), queries.end());
+    const vector<vector<Document>> expected = ProcessQueries(search_server, queries);
+
+    for (const QueryResultOrder order : {QueryResultOrder::QUERY_ORDER, QueryResultOrder::COMPLETION_ORDER}) {
+        vector<size_t> indexes;
+        vector<vector<Document>> results(queries.size());
+        atomic<int> active_callbacks = 0;
+        atomic<bool> is_overlapped = false;
+        ProcessQueriesStreamed(search_server, query_views, [&](size_t index, vector<Document> &&documents) {
+            if (++active_callbacks != 1) {
+                is_overlapped = true;
+            }
+            //медленный потребитель: остальные запросы успевают завершиться за время вызова
+            if (index % 10 == 0) {
+                this_thread::sleep_for(chrono::milliseconds(2));
+            }
+            indexes.push_back(index);
+            results[index] = move(documents);
+            --active_callbacks;
+        }, order);
+        ASSERT(!is_overlapped);
+        ASSERT_EQUAL(indexes.size(), queries.size());
+        if (order == QueryResultOrder::QUERY_ORDER) {
+            for (size_t i = 0; i < indexes.size(); ++i) {
+                ASSERT_EQUAL(indexes[i], i);
+            }
+        } else {
+            sort(indexes.begin(), indexes.end());
+            ASSERT(adjacent_find(indexes.begin(), indexes.end()) == indexes.end());
+        }
+        for (size_t i = 0; i < queries.size(); ++i) {
+            AssertSameDocuments(results[i], expected[i], queries[i]);
+        }
+    }
+
+    //исключение потребителя доходит до вызывающего
+    try {
+        ProcessQueriesStreamed(search_server, query_views, [](size_t index, vector<Document> &&) {
+            if (index == 5) {
+                throw runtime_error("consumer failed"s);
+            }
+        });
+        ASSERT_HINT(false, "consumer exception must be rethrown"s);
+    } catch (const runtime_error &) {
+    }
+
+    vector<Document> concatenated;
+    for (const vector<Document> &documents : expected) {
+        concatenated.insert(concatenated.end(), documents.begin(), documents.end());
+    }
+    const JoinedDocuments joined = ProcessQueriesJoined(search_server, queries);
+    ASSERT_EQUAL(joined.GetQueryCount(), queries.size());
+    ASSERT_EQUAL(joined.size(), concatenated.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto query_documents = joined.GetQueryDocuments(i);
+        AssertSameDocuments(vector<Document>(query_documents.begin(), query_documents.end()), expected[i], queries[i]);
+    }
+    AssertSameDocuments(vector<Document>(joined.begin(), joined.end()), concatenated, "joined iteration"s);
+    vector<Document> streamed;
+    ProcessQueriesJoined(search_server, query_views, back_inserter(streamed));
+    AssertSameDocuments(streamed, concatenated, "joined output iterator"s);
+}
+
+void TestSearchServer() {
+    RUN_TEST(TestCompactKeepsResults);
+    RUN_TEST(TestTombstones);
+    RUN_TEST(TestSnapshotRoundTrip);
+    RUN_TEST(TestSnapshotForwardIndex);
+    RUN_TEST(TestDurableServerRecovery);
+    RUN_TEST(TestWriteAheadLogRejectsBadStatus);
+    RUN_TEST(TestSegmentedServerMatchesSingleServer);
+    RUN_TEST(TestVersionedServerIsolatesViews);
+    RUN_TEST(TestPrunedTopMatchesFullRanking);
+    RUN_TEST(TestFrozenIndexWithTail);
+    RUN_TEST(TestQueryCacheInvalidation);
+    RUN_TEST(TestBatchByTermsMatchesSingleQueries);
+    RUN_TEST(TestCompiledQueryWithStatus);
+    RUN_TEST(TestStopWordFilter);
+    RUN_TEST(TestFrozenIndexRoundTrip);
+    RUN_TEST(TestTermDictionaryCopy);
+    RUN_TEST(TestTopDocumentsSelection);
+    RUN_TEST(TestScoreAccumulatorReuse);
+    RUN_TEST(TestParallelSlicesMatchSequential);
+    RUN_TEST(TestInverseDocumentFreqAfterChanges);
+    RUN_TEST(TestRemoveDocumentsBatch);
+    RUN_TEST(TestAddDocumentsMatchesSequentialAdds);
+    RUN_TEST(TestFrozenIndexBlockWidths);
+    RUN_TEST(TestFrozenIndexCursor);
+    RUN_TEST(TestSplitIntoWordsMatchesScalar);
+    RUN_TEST(TestSmallVectorSpill);
+    RUN_TEST(TestThreadPoolParallelFor);
+    RUN_TEST(TestStreamedAndJoinedResults);
+}
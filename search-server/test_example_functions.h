@@ -1 +1,4 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+//метод запускает тесты поисковой системы, при ошибке печатает проверку и завершает программу
+void TestSearchServer();
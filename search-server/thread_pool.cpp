@@ -0,0 +1,100 @@
+#include "thread_pool.h"
+
+using namespace std;
+
+thread_local const ThreadPool *ThreadPool::current_pool_ = nullptr;
+thread_local size_t ThreadPool::current_index_ = 0;
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    queues_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(make_unique<Queue>());
+    }
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i] {
+            RunWorker(i);
+        });
+    }
+}
+
+//потоки доделывают все поставленные задачи и завершаются
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard guard(sleep_mutex_);
+        is_stopping_ = true;
+    }
+    wake_.notify_all();
+    for (thread &worker : threads_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return threads_.size();
+}
+
+//общий пул процесса на все ядра
+const ThreadPool &ThreadPool::GetDefault() {
+    static const ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Submit(Task task) const {
+    //поток пула кладет задачу в свою очередь, чтобы она оставалась рядом с его данными
+    const size_t index = current_pool_ == this ? current_index_ : next_queue_.fetch_add(1) % queues_.size();
+    //счетчик увеличивается раньше, чем задача появляется в очереди, и никогда не становится меньше нуля
+    queued_count_.fetch_add(1);
+    {
+        lock_guard guard(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(move(task));
+    }
+    {
+        lock_guard guard(sleep_mutex_);
+    }
+    wake_.notify_one();
+}
+
+//метод выполняет одну задачу из очередей пула: сначала последнюю из своей очереди, затем самую старую из чужих
+bool ThreadPool::TryRunTask() const {
+    const bool is_worker = current_pool_ == this;
+    const size_t first = is_worker ? current_index_ : 0;
+    for (size_t i = 0; i < queues_.size(); ++i) {
+        Queue &queue = *queues_[(first + i) % queues_.size()];
+        Task task;
+        {
+            lock_guard guard(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (is_worker && i == 0) {
+                task = move(queue.tasks.back());
+                queue.tasks.pop_back();
+            } else {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        queued_count_.fetch_sub(1);
+        task();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::RunWorker(size_t index) {
+    current_pool_ = this;
+    current_index_ = index;
+    while (true) {
+        if (TryRunTask()) {
+            continue;
+        }
+        unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] {
+            return is_stopping_ || queued_count_.load() > 0;
+        });
+        if (is_stopping_ && queued_count_.load() == 0) {
+            return;
+        }
+    }
+}
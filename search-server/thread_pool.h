@@ -0,0 +1,129 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <exception>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+//пул потоков с перехватом работы: у каждого потока своя очередь задач, свои задачи он берет с конца,
+//а опустошив очередь, забирает самые старые задачи из очередей других потоков.
+//пул можно передать в методы поиска вместо политики выполнения: server.FindTopDocuments(pool, query)
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t GetThreadCount() const;
+
+    //метод вызывает function(index) для каждого index из [0, count) на потоках пула и ждет завершения.
+    //номера раздаются по одному, поэтому долгие вызовы не задерживают остальные. вызывающий поток
+    //тоже выполняет номера, а пока ждет — чужие задачи пула, поэтому вложенный ParallelFor не блокирует пул.
+    //первое исключение из function бросается после завершения всех вызовов
+    template <typename Function>
+    void ParallelFor(size_t count, Function function) const;
+
+    //общий пул процесса на все ядра
+    static const ThreadPool &GetDefault();
+
+private:
+    using Task = std::function<void()>;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    //очередь i принадлежит потоку i, задачи извне раскладываются по очередям по кругу
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    mutable std::atomic<size_t> queued_count_{0};
+    mutable std::atomic<size_t> next_queue_{0};
+    mutable std::mutex sleep_mutex_;
+    mutable std::condition_variable wake_;
+    bool is_stopping_ = false;
+
+    //пул и номер потока, выполняющего код, для потоков вне пула — nullptr
+    static thread_local const ThreadPool *current_pool_;
+    static thread_local size_t current_index_;
+
+    void Submit(Task task) const;
+    //метод выполняет одну задачу из очередей пула, если она есть
+    bool TryRunTask() const;
+    void RunWorker(size_t index);
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor(size_t count, Function function) const {
+    if (count <= 1 || threads_.empty()) {
+        //без потоков пула вызовы идут подряд, но исключение так же бросается после всех вызовов
+        std::exception_ptr error;
+        for (size_t index = 0; index < count; ++index) {
+            try {
+                function(index);
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return;
+    }
+    struct State {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t count = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    //function живет в кадре вызывающего потока: задача, начавшаяся после возврата из ParallelFor,
+    //не найдет свободных номеров и к function не обратится
+    const auto run = [state, &function]() {
+        for (size_t index = state->next.fetch_add(1); index < state->count; index = state->next.fetch_add(1)) {
+            try {
+                function(index);
+            } catch (...) {
+                std::lock_guard guard(state->mutex);
+                if (!state->error) {
+                    state->error = std::current_exception();
+                }
+            }
+            if (state->done.fetch_add(1, std::memory_order_acq_rel) + 1 == state->count) {
+                std::lock_guard guard(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+    const size_t helper_count = std::min(count, threads_.size() + 1) - 1;
+    for (size_t i = 0; i < helper_count; ++i) {
+        Submit(run);
+    }
+    run();
+    while (state->done.load(std::memory_order_acquire) < count) {
+        if (TryRunTask()) {
+            continue;
+        }
+        std::unique_lock lock(state->mutex);
+        state->finished.wait(lock, [&state, count] {
+            return state->done.load(std::memory_order_acquire) == count;
+        });
+    }
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+#include "document.h"
+
+constexpr double PRECISION = 1e-6;
+
+//метод сравнения документов: выше релевантность, при равной релевантности выше рейтинг
+inline bool IsRankedHigher(const Document &lhs, const Document &rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < PRECISION) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+//класс отбора лучших документов: хранит не более max_count документов в куче,
+//на вершине которой худший из отобранных, поэтому отбор стоит O(N log K) вместо сортировки всех N
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t max_count)
+            : max_count_(max_count) {
+    }
+
+    //метод предлагает документ в отбор
+    void Add(const Document &document) {
+        if (documents_.size() < max_count_) {
+            documents_.push_back(document);
+            std::push_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+        } else if (max_count_ > 0 && IsRankedHigher(document, documents_.front())) {
+            std::pop_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+            documents_.back() = document;
+            std::push_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+        }
+    }
+
+    //метод возвращает порог отбора: документ с релевантностью ниже порога не войдет в отбор при любом рейтинге.
+    //пока отбор не заполнен, порога нет
+    double GetThreshold() const {
+        if (max_count_ == 0) {
+            return std::numeric_limits<double>::infinity();
+        }
+        if (documents_.size() < max_count_) {
+            return -std::numeric_limits<double>::infinity();
+        }
+        return documents_.front().relevance - PRECISION;
+    }
+
+    //метод объединяет отбор с отбором другого потока
+    void Merge(const TopDocuments &other) {
+        for (const Document &document: other.documents_) {
+            Add(document);
+        }
+    }
+
+    //метод возвращает отобранные документы, отсортированные от лучшего к худшему
+    std::vector<Document> Release() {
+        std::sort_heap(documents_.begin(), documents_.end(), IsRankedHigher);
+        return std::move(documents_);
+    }
+
+private:
+    size_t max_count_;
+    std::vector<Document> documents_;
+};
@@ -0,0 +1,202 @@
+#include "versioned_search_server.h"
+
+using namespace std;
+
+VersionedSearchServer::View::View(shared_ptr<const Version> version)
+        : version_(move(version)) {
+}
+
+//метод поиска топ докуметов с заданным статусом
+vector<Document> VersionedSearchServer::View::FindTopDocuments(string_view raw_query, DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(execution::seq, raw_query, status, max_count);
+}
+
+//метод поиска топ докуметов с актуальным статусом
+vector<Document> VersionedSearchServer::View::FindTopDocuments(string_view raw_query) const {
+    return FindTopDocuments(execution::seq, raw_query, DocumentStatus::ACTUAL);
+}
+
+//метод возвращает плюс-слова запроса, содержащиеся в документе. документ ищется сначала в дельте:
+//документ, удаленный из основы и добавленный заново, лежит там
+tuple<vector<string_view>, DocumentStatus> VersionedSearchServer::View::MatchDocument(string_view raw_query, int document_id) const {
+    for (const auto &segment : version_->delta) {
+        if (segment->HasDocument(document_id)) {
+            return segment->MatchDocument(raw_query, document_id);
+        }
+    }
+    if (version_->removed->Contains(document_id)) {
+        throw out_of_range("Invalid document_id");
+    }
+    return version_->base->MatchDocument(raw_query, document_id);
+}
+
+//метод возвращает количество документов версии
+int VersionedSearchServer::View::GetDocumentCount() const {
+    return version_->base->GetDocumentCount() - version_->removed->GetCount() + version_->delta_document_count;
+}
+
+//метод проверяет, есть ли документ в версии
+bool VersionedSearchServer::View::HasDocument(int document_id) const {
+    return VersionedSearchServer::HasDocument(*version_, document_id);
+}
+
+//номер версии, каждое изменение публикует следующий номер
+uint64_t VersionedSearchServer::View::GetVersion() const {
+    return version_->number;
+}
+
+VersionedSearchServer::VersionedSearchServer(string_view stop_words_text, size_t delta_capacity)
+        : stop_words_text_(stop_words_text), delta_capacity_(max<size_t>(1, delta_capacity)) {
+    auto base = make_shared<SearchServer>(stop_words_text_);
+    base->Freeze();
+    auto version = make_shared<Version>();
+    version->base = move(base);
+    version->removed = make_shared<const RemovedDocuments>();
+    version_ = move(version);
+}
+
+//метод возвращает снимок текущей версии: ссылка на версию берется атомарно, писатель не ждется
+VersionedSearchServer::View VersionedSearchServer::GetView() const {
+    return View(LoadVersion());
+}
+
+//метод добавляет документ новым сегментом дельты и публикует новую версию
+void VersionedSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status, const vector<int> &ratings) {
+    lock_guard guard(writer_mutex_);
+    const auto current = LoadVersion();
+    if (HasDocument(*current, document_id)) {
+        throw invalid_argument("Invalid document_id");
+    }
+    auto segment = make_shared<SearchServer>(stop_words_text_);
+    segment->AddDocument(document_id, document, status, ratings);
+    Publish(*current, current->base, current->removed, AppendDeltaSegment(current->delta, move(segment)));
+}
+
+//метод пакетно добавляет документы одной версией
+void VersionedSearchServer::AddDocuments(const vector<NewDocument> &documents) {
+    lock_guard guard(writer_mutex_);
+    const auto current = LoadVersion();
+    for (const NewDocument &document : documents) {
+        if (HasDocument(*current, document.id)) {
+            throw invalid_argument("Invalid document_id");
+        }
+    }
+    auto segment = make_shared<SearchServer>(stop_words_text_);
+    segment->AddDocuments(execution::par, documents);
+    Publish(*current, current->base, current->removed, AppendDeltaSegment(current->delta, move(segment)));
+}
+
+//метод удаляет документ и публикует новую версию
+void VersionedSearchServer::RemoveDocument(int document_id) {
+    RemoveDocuments({document_id});
+}
+
+//метод пакетно удаляет документы одной версией: копируются только сегменты дельты с удаляемыми документами.
+//документы основы отмечаются в копии удалений основы вместе с поправками документной частоты их слов,
+//основа не копируется
+void VersionedSearchServer::RemoveDocuments(const vector<int> &document_ids) {
+    lock_guard guard(writer_mutex_);
+    const auto current = LoadVersion();
+    const SearchServer &base = *current->base;
+    map<size_t, vector<int>> segment_ids;
+    vector<int> base_ids;
+    for (const int document_id : document_ids) {
+        const auto segment = find_if(current->delta.begin(), current->delta.end(), [document_id](const auto &segment) {
+            return segment->HasDocument(document_id);
+        });
+        if (segment != current->delta.end()) {
+            segment_ids[segment - current->delta.begin()].push_back(document_id);
+        } else if (base.HasDocument(document_id) && !current->removed->Contains(document_id)) {
+            base_ids.push_back(document_id);
+        }
+    }
+
+    DeltaSegments delta = current->delta;
+    //сегменты обходятся с конца, чтобы удаление опустевшего сегмента не сдвигало номера остальных
+    for (auto it = segment_ids.rbegin(); it != segment_ids.rend(); ++it) {
+        auto segment = make_shared<SearchServer>(*delta[it->first]);
+        segment->RemoveDocuments(it->second);
+        //сегмент мал, и уплотнение не дает его номерам документов расти
+        segment->Compact();
+        if (segment->GetDocumentCount() == 0) {
+            delta.erase(delta.begin() + it->first);
+        } else {
+            delta[it->first] = move(segment);
+        }
+    }
+
+    shared_ptr<const RemovedDocuments> removed = current->removed;
+    if (!base_ids.empty()) {
+        auto removed_copy = make_shared<RemovedDocuments>(*removed);
+        removed_copy->Add(base, base_ids);
+        removed = move(removed_copy);
+    }
+    Publish(*current, current->base, move(removed), move(delta));
+}
+
+shared_ptr<const VersionedSearchServer::Version> VersionedSearchServer::LoadVersion() const {
+    return atomic_load(&version_);
+}
+
+//метод проверяет, есть ли документ в версии
+bool VersionedSearchServer::HasDocument(const Version &version, int document_id) {
+    for (const auto &segment : version.delta) {
+        if (segment->HasDocument(document_id)) {
+            return true;
+        }
+    }
+    return version.base->HasDocument(document_id) && !version.removed->Contains(document_id);
+}
+
+//метод дописывает к дельте сегмент с новыми документами. пока последний сегмент не больше нового, они сливаются,
+//поэтому размеры сегментов убывают от старых к новым. при добавлении по одному документу сегменты ведут себя
+//как двоичный счетчик: сегментов O(log дельты), и каждый документ копируется O(log дельты) раз,
+//а не вся дельта на каждое добавление. предыдущие версии продолжают делить прежние сегменты
+VersionedSearchServer::DeltaSegments VersionedSearchServer::AppendDeltaSegment(DeltaSegments delta, shared_ptr<SearchServer> segment) {
+    while (!delta.empty() && delta.back()->GetDocumentCount() <= segment->GetDocumentCount()) {
+        auto merged = make_shared<SearchServer>(*delta.back());
+        merged->AddDocuments(*segment);
+        segment = move(merged);
+        delta.pop_back();
+    }
+    delta.push_back(move(segment));
+    return delta;
+}
+
+//метод собирает основу и дельту версии в один замороженный сервер. в копии основы удаленные документы
+//только помечаются, а документы дельты дописываются в хвост замороженного индекса по ее прямому индексу,
+//поэтому копия не размораживается: уплотнение и заморозка сразу собирают новые сжатые списки
+shared_ptr<SearchServer> VersionedSearchServer::MergeVersion(const Version &version) {
+    auto merged = make_shared<SearchServer>(*version.base);
+    const set<int> &removed = version.removed->GetDocumentIds();
+    if (!removed.empty()) {
+        merged->RemoveDocuments(vector<int>(removed.begin(), removed.end()));
+    }
+    for (const auto &segment : version.delta) {
+        merged->AddDocuments(*segment);
+    }
+    merged->Compact();
+    merged->Freeze();
+    return merged;
+}
+
+//метод публикует следующую версию. при переполнении дельты основа собирается заново,
+//а прежняя основа освобождается вместе с последним снимком, который на нее ссылается
+void VersionedSearchServer::Publish(const Version &current, shared_ptr<const SearchServer> base, shared_ptr<const RemovedDocuments> removed,
+                                    DeltaSegments delta) {
+    auto next = make_shared<Version>();
+    next->base = move(base);
+    next->removed = move(removed);
+    next->delta = move(delta);
+    for (const auto &segment : next->delta) {
+        next->delta_document_count += segment->GetDocumentCount();
+    }
+    next->number = current.number + 1;
+    if (static_cast<size_t>(next->delta_document_count + next->removed->GetCount()) >= delta_capacity_) {
+        next->base = MergeVersion(*next);
+        next->removed = make_shared<const RemovedDocuments>();
+        next->delta.clear();
+        next->delta_document_count = 0;
+    }
+    atomic_store(&version_, shared_ptr<const Version>(move(next)));
+}
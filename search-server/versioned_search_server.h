@@ -0,0 +1,198 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <cmath>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <execution>
+#include <string_view>
+
+#include "search_server.h"
+#include "top_documents.h"
+#include "removed_documents.h"
+
+//количество документов дельты и удалений из основы, после которого версия собирается в новую основу
+const size_t DEFAULT_VERSION_DELTA_CAPACITY = 1024;
+
+//поисковый сервер с изоляцией читателей: поиск идет по неизменяемой версии и никогда не ждет писателя.
+//версия состоит из замороженной основы, небольшой дельты с новыми документами и документов основы,
+//удаленных после ее сборки. основа общая для всех версий. дельта — неизменяемые сегменты, общие с
+//предыдущими версиями: добавление создает сегмент из новых документов и сливает его только с меньшими
+//последними сегментами, а удаление копирует только свой сегмент и удаления основы. новая версия
+//публикуется атомарной заменой указателя, прежняя освобождается подсчетом ссылок, когда разрушен последний ее снимок.
+//когда дельта и удаления вырастают до delta_capacity, писатель собирает из версии новую основу за O(индекса),
+//читатели в это время ищут по прежней версии. запрос обходит основу и дельту с общим IDF всей версии,
+//поэтому результат совпадает с одним SearchServer
+class VersionedSearchServer {
+    struct Version;
+
+public:
+    //снимок для чтения: пока он жив, его версия не изменяется и не освобождается.
+    //писатель не ждет читателей, поэтому снимок можно держать и во время изменений, в том числе в том же потоке
+    class View {
+    public:
+        //однопоточный/паралельный метод поиска топ докуметов с лямбдой
+        template <typename DocumentPredicate, typename Policy>
+        std::vector<Document> FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                                               size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        //однопоточный/паралельный метод поиска топ докуметов с заданным статусом
+        template <typename Policy>
+        std::vector<Document> FindTopDocuments(const Policy &policy, std::string_view raw_query, DocumentStatus status,
+                                               size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        //метод поиска топ докуметов с лямбдой
+        template <typename DocumentPredicate>
+        std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                               size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        //метод поиска топ докуметов с заданным статусом
+        std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                               size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+        //метод поиска топ докуметов с актуальным статусом
+        std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+        //метод возвращает плюс-слова запроса, содержащиеся в документе, для неизвестного id бросает out_of_range
+        std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+        //метод возвращает количество документов версии
+        int GetDocumentCount() const;
+        //метод проверяет, есть ли документ в версии
+        bool HasDocument(int document_id) const;
+
+        //номер версии, каждое изменение публикует следующий номер
+        uint64_t GetVersion() const;
+
+    private:
+        friend class VersionedSearchServer;
+
+        explicit View(std::shared_ptr<const Version> version);
+
+        std::shared_ptr<const Version> version_;
+    };
+
+    explicit VersionedSearchServer(std::string_view stop_words_text, size_t delta_capacity = DEFAULT_VERSION_DELTA_CAPACITY);
+
+    //метод возвращает снимок текущей версии, не блокируясь на писателе
+    View GetView() const;
+
+    //метод добавляет документ и публикует новую версию
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int> &ratings);
+    //метод пакетно добавляет документы одной версией
+    void AddDocuments(const std::vector<NewDocument> &documents);
+    //метод удаляет документ и публикует новую версию
+    void RemoveDocument(int document_id);
+    //метод пакетно удаляет документы одной версией
+    void RemoveDocuments(const std::vector<int> &document_ids);
+
+    //метод применяет произвольное изменение ко всему серверу и публикует его одной версией.
+    //основа собирается заново вместе с дельтой, поэтому изменение стоит O(индекса).
+    //если изменение бросает исключение, версия не публикуется
+    template <typename Mutation>
+    void Update(Mutation mutation);
+
+private:
+    //сегменты дельты от старых к новым
+    using DeltaSegments = std::vector<std::shared_ptr<const SearchServer>>;
+
+    struct Version {
+        //замороженная основа, общая для версий
+        std::shared_ptr<const SearchServer> base;
+        //документы основы, удаленные после ее сборки, общие для версий, между которыми из основы ничего не удалялось
+        std::shared_ptr<const RemovedDocuments> removed;
+        //документы, добавленные после сборки основы
+        DeltaSegments delta;
+        int delta_document_count = 0;
+        uint64_t number = 0;
+    };
+
+    std::string stop_words_text_;
+    size_t delta_capacity_;
+    //текущая версия, читается и заменяется атомарно
+    std::shared_ptr<const Version> version_;
+    //писатели изменяют сервер по очереди, читатели эту блокировку не берут
+    std::mutex writer_mutex_;
+
+    std::shared_ptr<const Version> LoadVersion() const;
+    //метод проверяет, есть ли документ в версии
+    static bool HasDocument(const Version &version, int document_id);
+    //метод дописывает к дельте сегмент с новыми документами, сливая его с не большими последними сегментами
+    static DeltaSegments AppendDeltaSegment(DeltaSegments delta, std::shared_ptr<SearchServer> segment);
+    //метод собирает основу и дельту версии в один замороженный сервер
+    static std::shared_ptr<SearchServer> MergeVersion(const Version &version);
+    //метод публикует следующую за current версию, при переполнении дельты собирает новую основу.
+    //вызывается под writer_mutex_
+    void Publish(const Version &current, std::shared_ptr<const SearchServer> base, std::shared_ptr<const RemovedDocuments> removed,
+                 DeltaSegments delta);
+};
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> VersionedSearchServer::View::FindTopDocuments(const Policy &policy, std::string_view raw_query,
+                                                                    DocumentPredicate document_predicate, size_t max_count) const {
+    const SearchServer &base = *version_->base;
+    const RemovedDocuments &removed = *version_->removed;
+
+    //общая статистика версии: документы основы без удаленных и документы дельты.
+    //стоп-слова у основы и дельты общие, поэтому запрос проверяется и разбирается основой
+    std::vector<std::pair<std::string_view, int>> document_freqs;
+    for (std::string_view word : base.ParseQueryPlusWords(raw_query)) {
+        int document_freq = base.GetDocumentFrequency(word) - removed.GetDocumentFrequency(word);
+        for (const auto &segment : version_->delta) {
+            document_freq += segment->GetDocumentFrequency(word);
+        }
+        document_freqs.emplace_back(word, document_freq);
+    }
+    const double log_document_count = std::log(static_cast<double>(GetDocumentCount()));
+    const auto inverse_document_freq = [&document_freqs, log_document_count](std::string_view word) {
+        const auto it = std::lower_bound(document_freqs.begin(), document_freqs.end(), std::pair(word, 0));
+        if (it == document_freqs.end() || it->first != word || it->second == 0) {
+            return 0.0;
+        }
+        return log_document_count - std::log(static_cast<double>(it->second));
+    };
+
+    //удаленные документы основы пропускаются по битовой карте, фильтр по статусу остается на карте статуса
+    std::vector<Document> base_top;
+    if (removed.GetCount() == 0) {
+        base_top = base.FindTopDocuments(policy, raw_query, document_predicate, max_count, inverse_document_freq);
+    } else {
+        base_top = base.FindTopDocuments(policy, raw_query, removed.MakeFilter(document_predicate), max_count, inverse_document_freq);
+    }
+    TopDocuments top_documents(max_count);
+    for (const Document &document : base_top) {
+        top_documents.Add(document);
+    }
+    for (const auto &segment : version_->delta) {
+        for (const Document &document : segment->FindTopDocuments(policy, raw_query, document_predicate, max_count, inverse_document_freq)) {
+            top_documents.Add(document);
+        }
+    }
+    return top_documents.Release();
+}
+
+template <typename Policy>
+std::vector<Document> VersionedSearchServer::View::FindTopDocuments(const Policy &policy, std::string_view raw_query,
+                                                                    DocumentStatus status, size_t max_count) const {
+    return FindTopDocuments(policy, raw_query, DocumentStatusFilter{status}, max_count);
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> VersionedSearchServer::View::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                                    size_t max_count) const {
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_count);
+}
+
+template <typename Mutation>
+void VersionedSearchServer::Update(Mutation mutation) {
+    std::lock_guard guard(writer_mutex_);
+    const auto current = LoadVersion();
+    std::shared_ptr<SearchServer> merged = MergeVersion(*current);
+    mutation(*merged);
+    merged->Compact();
+    merged->Freeze();
+    Publish(*current, std::move(merged), std::make_shared<const RemovedDocuments>(), {});
+}
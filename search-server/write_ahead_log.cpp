@@ -0,0 +1,300 @@
+#include "write_ahead_log.h"
+#include "search_server.h"
+#include "snapshot_io.h"
+#include <filesystem>
+#include <execution>
+#include <stdexcept>
+#include <cstring>
+#include <array>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define WRITE_AHEAD_LOG_USE_FSYNC 1
+#endif
+
+using namespace std;
+
+namespace {
+    const char LOG_SIGNATURE[8] = {'S', 'R', 'C', 'H', 'W', 'L', 'O', 'G'};
+    const uint32_t LOG_BYTE_ORDER = 0x01020304;
+    const size_t LOG_HEADER_SIZE = sizeof(LOG_SIGNATURE) + 2 * sizeof(uint32_t);
+    //рамка записи: длина полезной нагрузки и ее контрольная сумма
+    const size_t RECORD_FRAME_SIZE = 2 * sizeof(uint32_t);
+    //наибольший пакет добавлений при доигрывании журнала
+    const size_t REPLAY_BATCH_SIZE = 1 << 14;
+
+    enum RecordType : uint8_t {
+        RECORD_ADD = 1,
+        RECORD_REMOVE = 2,
+    };
+
+    //метод считает CRC32 (полином 0xEDB88320) табличным способом
+    uint32_t ComputeChecksum(string_view data) {
+        static const array<uint32_t, 256> table = [] {
+            array<uint32_t, 256> result{};
+            for (uint32_t i = 0; i < result.size(); ++i) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+                }
+                result[i] = value;
+            }
+            return result;
+        }();
+        uint32_t checksum = 0xFFFFFFFFu;
+        for (const char c : data) {
+            checksum = table[(checksum ^ static_cast<uint8_t>(c)) & 0xFF] ^ (checksum >> 8);
+        }
+        return checksum ^ 0xFFFFFFFFu;
+    }
+
+    template <typename T>
+    void AppendValue(string& out, const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    //метод проверяет заголовок журнала
+    void CheckHeader(const char* data, size_t size) {
+        if (size < LOG_HEADER_SIZE || memcmp(data, LOG_SIGNATURE, sizeof(LOG_SIGNATURE)) != 0) {
+            throw runtime_error("File is not a search server write-ahead log");
+        }
+        SnapshotReader reader(data + sizeof(LOG_SIGNATURE), size - sizeof(LOG_SIGNATURE));
+        if (reader.Read<uint32_t>() != WRITE_AHEAD_LOG_VERSION) {
+            throw runtime_error("Unsupported write-ahead log version");
+        }
+        if (reader.Read<uint32_t>() != LOG_BYTE_ORDER) {
+            throw runtime_error("Write-ahead log byte order does not match");
+        }
+    }
+
+    //метод обходит целые записи с верной контрольной суммой и возвращает конец последней из них,
+    //обход останавливается на первой оборванной или поврежденной записи
+    template <typename Function>
+    size_t ForEachRecord(const char* data, size_t size, Function function) {
+        size_t position = LOG_HEADER_SIZE;
+        while (size - position >= RECORD_FRAME_SIZE) {
+            uint32_t payload_size = 0;
+            uint32_t checksum = 0;
+            memcpy(&payload_size, data + position, sizeof(payload_size));
+            memcpy(&checksum, data + position + sizeof(payload_size), sizeof(checksum));
+            if (payload_size > size - position - RECORD_FRAME_SIZE) {
+                break;
+            }
+            const string_view payload(data + position + RECORD_FRAME_SIZE, payload_size);
+            if (ComputeChecksum(payload) != checksum) {
+                break;
+            }
+            function(payload);
+            position += RECORD_FRAME_SIZE + payload_size;
+        }
+        return position;
+    }
+
+    //метод дописывает данные в файл и дожидается их записи на диск
+    bool WriteAndSync(FILE* file, const string& data) {
+        if (fwrite(data.data(), 1, data.size(), file) != data.size() || fflush(file) != 0) {
+            return false;
+        }
+#ifdef WRITE_AHEAD_LOG_USE_FSYNC
+        return fsync(fileno(file)) == 0;
+#else
+        return true;
+#endif
+    }
+}
+
+//метод открывает журнал, создавая его при отсутствии, и отрезает оборванный хвост
+WriteAheadLog::WriteAheadLog(const string& path)
+        : path_(path) {
+    error_code error;
+    const uintmax_t size = filesystem::file_size(path_, error);
+    if (error || size < LOG_HEADER_SIZE) {
+        //нового журнала нет или сбой случился при записи заголовка
+        WriteHeader();
+        return;
+    }
+    size_t valid_size = 0;
+    {
+        const MappedFile file(path_);
+        CheckHeader(file.GetData(), file.GetSize());
+        valid_size = ForEachRecord(file.GetData(), file.GetSize(), [](string_view) {});
+    }
+    if (valid_size < size) {
+        filesystem::resize_file(path_, valid_size);
+    }
+    file_ = fopen(path_.c_str(), "ab");
+    if (!file_) {
+        throw runtime_error("Cannot open write-ahead log " + path_);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (file_) {
+        fclose(file_);
+    }
+}
+
+//метод ставит в очередь запись о добавлении документа, возвращает ее номер
+uint64_t WriteAheadLog::AppendAdd(int document_id, string_view document, DocumentStatus status,
+                                  const vector<int>& ratings) {
+    string payload;
+    payload.reserve(sizeof(uint8_t) * 2 + sizeof(int32_t) * (ratings.size() + 1) + sizeof(uint32_t) * 2 + document.size());
+    AppendValue(payload, RECORD_ADD);
+    AppendValue(payload, static_cast<int32_t>(document_id));
+    AppendValue(payload, static_cast<uint8_t>(status));
+    AppendValue(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        AppendValue(payload, static_cast<int32_t>(rating));
+    }
+    AppendValue(payload, static_cast<uint32_t>(document.size()));
+    payload.append(document);
+    return Append(payload);
+}
+
+//метод ставит в очередь запись об удалении документа, возвращает ее номер
+uint64_t WriteAheadLog::AppendRemove(int document_id) {
+    string payload;
+    AppendValue(payload, RECORD_REMOVE);
+    AppendValue(payload, static_cast<int32_t>(document_id));
+    return Append(payload);
+}
+
+//метод ждет, пока запись не окажется на диске. первый пришедший поток забирает весь буфер
+//и делает один fsync, остальные ждут его результата
+void WriteAheadLog::WaitDurable(uint64_t sequence_number) {
+    unique_lock lock(mutex_);
+    while (durable_count_ < sequence_number) {
+        if (is_failed_) {
+            throw runtime_error("Cannot write to write-ahead log " + path_);
+        }
+        if (is_flushing_) {
+            durable_.wait(lock);
+            continue;
+        }
+        is_flushing_ = true;
+        string batch;
+        batch.swap(pending_);
+        const uint64_t batch_end = appended_count_;
+        lock.unlock();
+        const bool is_written = WriteAndSync(file_, batch);
+        lock.lock();
+        is_flushing_ = false;
+        if (is_written) {
+            durable_count_ = batch_end;
+        } else {
+            is_failed_ = true;
+        }
+        durable_.notify_all();
+    }
+}
+
+//метод сбрасывает на диск все поставленные в очередь записи
+void WriteAheadLog::Sync() {
+    uint64_t sequence_number = 0;
+    {
+        lock_guard guard(mutex_);
+        sequence_number = appended_count_;
+    }
+    WaitDurable(sequence_number);
+}
+
+//метод очищает журнал после того, как его записи попали в снимок
+void WriteAheadLog::Reset() {
+    Sync();
+    unique_lock lock(mutex_);
+    durable_.wait(lock, [this] {
+        return !is_flushing_;
+    });
+    fclose(file_);
+    file_ = nullptr;
+    WriteHeader();
+}
+
+//метод доигрывает записи журнала на сервере пакетами
+void WriteAheadLog::Replay(SearchServer& search_server) const {
+    const MappedFile file(path_);
+    CheckHeader(file.GetData(), file.GetSize());
+
+    //тексты добавляемых документов указывают прямо в отображение журнала
+    vector<NewDocument> added;
+    vector<int> removed;
+    const auto apply_added = [&] {
+        if (added.empty()) {
+            return;
+        }
+        vector<int> document_ids;
+        document_ids.reserve(added.size());
+        for (const NewDocument& document : added) {
+            document_ids.push_back(document.id);
+        }
+        search_server.RemoveDocuments(execution::par, document_ids);
+        search_server.AddDocuments(execution::par, added);
+        added.clear();
+    };
+    const auto apply_removed = [&] {
+        if (!removed.empty()) {
+            search_server.RemoveDocuments(execution::par, removed);
+            removed.clear();
+        }
+    };
+
+    ForEachRecord(file.GetData(), file.GetSize(), [&](string_view payload) {
+        SnapshotReader reader(payload.data(), payload.size());
+        const auto type = reader.Read<uint8_t>();
+        const int document_id = reader.Read<int32_t>();
+        if (type != RECORD_ADD && type != RECORD_REMOVE) {
+            throw runtime_error("Write-ahead log record is corrupted");
+        }
+        if (type == RECORD_REMOVE) {
+            apply_added();
+            removed.push_back(document_id);
+            return;
+        }
+        apply_removed();
+        NewDocument document;
+        document.id = document_id;
+        const auto status = reader.Read<uint8_t>();
+        if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+            throw runtime_error("Write-ahead log record is corrupted");
+        }
+        document.status = static_cast<DocumentStatus>(status);
+        document.ratings.resize(reader.Read<uint32_t>());
+        for (int& rating : document.ratings) {
+            rating = reader.Read<int32_t>();
+        }
+        document.text = reader.ReadString();
+        added.push_back(move(document));
+        if (added.size() == REPLAY_BATCH_SIZE) {
+            apply_added();
+        }
+    });
+    apply_added();
+    apply_removed();
+}
+
+uint64_t WriteAheadLog::Append(const string& payload) {
+    lock_guard guard(mutex_);
+    if (is_failed_) {
+        throw runtime_error("Cannot write to write-ahead log " + path_);
+    }
+    AppendValue(pending_, static_cast<uint32_t>(payload.size()));
+    AppendValue(pending_, ComputeChecksum(payload));
+    pending_.append(payload);
+    return ++appended_count_;
+}
+
+//метод создает пустой журнал с заголовком
+void WriteAheadLog::WriteHeader() {
+    file_ = fopen(path_.c_str(), "wb");
+    if (!file_) {
+        throw runtime_error("Cannot create write-ahead log " + path_);
+    }
+    string header(LOG_SIGNATURE, sizeof(LOG_SIGNATURE));
+    AppendValue(header, WRITE_AHEAD_LOG_VERSION);
+    AppendValue(header, LOG_BYTE_ORDER);
+    if (!WriteAndSync(file_, header)) {
+        fclose(file_);
+        file_ = nullptr;
+        throw runtime_error("Cannot write to write-ahead log " + path_);
+    }
+}
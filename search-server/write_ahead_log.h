@@ -0,0 +1,70 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <string_view>
+#include <condition_variable>
+
+#include "document.h"
+
+class SearchServer;
+
+//версия формата журнала, увеличивается при любом изменении раскладки записи
+const uint32_t WRITE_AHEAD_LOG_VERSION = 1;
+
+//журнал упреждающей записи: AddDocument и RemoveDocument дописываются в конец файла
+//записями с длиной и контрольной суммой CRC32.
+//записи копятся в буфере и сбрасываются на диск группами: один поток пишет и вызывает fsync
+//за всех, кто ждет к этому моменту, поэтому запись не упирается в число fsync в секунду
+class WriteAheadLog {
+public:
+    //метод открывает журнал, создавая его при отсутствии. оборванный хвост
+    //(неполная или поврежденная запись после сбоя) отрезается, чужой файл вызывает runtime_error
+    explicit WriteAheadLog(const std::string &path);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    //метод ставит в очередь запись о добавлении документа, возвращает ее номер
+    uint64_t AppendAdd(int document_id, std::string_view document, DocumentStatus status,
+                       const std::vector<int> &ratings);
+
+    //метод ставит в очередь запись об удалении документа, возвращает ее номер
+    uint64_t AppendRemove(int document_id);
+
+    //метод ждет, пока запись с номером sequence_number не окажется на диске.
+    //при ошибке записи бросает runtime_error, после нее журнал больше не принимает записи
+    void WaitDurable(uint64_t sequence_number);
+
+    //метод сбрасывает на диск все поставленные в очередь записи
+    void Sync();
+
+    //метод очищает журнал после того, как его записи попали в снимок
+    void Reset();
+
+    //метод доигрывает записи журнала на сервере. подряд идущие добавления и удаления
+    //применяются пакетами AddDocuments и RemoveDocuments, добавление уже известного документа
+    //заменяет его, поэтому журнал можно доигрывать поверх снимка, в который вошла часть записей.
+    //запись с верной контрольной суммой, но неизвестным типом или статусом вызывает runtime_error
+    void Replay(SearchServer &search_server) const;
+
+private:
+    std::string path_;
+    std::FILE *file_ = nullptr;
+
+    std::mutex mutex_;
+    std::condition_variable durable_;
+    //записи, поставленные в очередь и еще не переданные на диск
+    std::string pending_;
+    uint64_t appended_count_ = 0;
+    uint64_t durable_count_ = 0;
+    bool is_flushing_ = false;
+    bool is_failed_ = false;
+
+    uint64_t Append(const std::string &payload);
+    void WriteHeader();
+};